@@ -0,0 +1,61 @@
+#include <swoole/Coroutine.hpp>
+#include <iostream>
+
+using namespace std;
+using namespace swoole;
+
+class MyServer : public CoServer
+{
+public:
+    MyServer(string _host, int _port) :
+            CoServer(_host, _port)
+    {
+        serv.worker_num = 2;
+        SwooleG.task_worker_num = 2;
+    }
+
+    virtual void onStart() {}
+    virtual void onShutdown() {}
+    virtual void onWorkerStart(int worker_id) {}
+    virtual void onWorkerStop(int worker_id) {}
+    virtual void onPipeMessage(int src_worker_id, const DataBuffer &) {}
+    virtual void onPacket(const DataBuffer &data, ClientInfo &clientInfo) {}
+
+    virtual void onTask(int task_id, int src_worker_id, const DataBuffer &data)
+    {
+        DataBuffer result((char *) data.buffer, data.length);
+        finish(result);
+    }
+
+    //read a line, wait a moment, hand it to a task worker, then echo the result, until the client leaves
+    virtual Task onConnection(int fd)
+    {
+        while (true)
+        {
+            string line = co_await recv(fd);
+            if (line.empty())
+            {
+                break;
+            }
+            if (!co_await sleep(fd, 100))
+            {
+                break;
+            }
+            string result = co_await task(fd, DataBuffer(line.c_str(), line.length()));
+            if (result.empty())
+            {
+                break;
+            }
+            send(fd, result.c_str(), (int) result.length());
+        }
+        printf("PID=%d\tconnection#%d is finished\n", getpid(), fd);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    MyServer server("127.0.0.1", 9501);
+    server.setEvents(EVENT_onConnect | EVENT_onReceive | EVENT_onClose | EVENT_onTask | EVENT_onFinish);
+    server.start();
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <swoole/Resp.hpp>
+#include <netinet/tcp.h>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace swoole;
+
+/**
+ * ./resp_bench server <worker_num>
+ * ./resp_bench client <connections> <requests> <pipeline>
+ *
+ * The client sends SET and then GET in pipelines of <pipeline> commands per connection,
+ * redis-benchmark -p 6380 -P 16 -t set,get works against the server as well.
+ */
+class CacheServer : public Server
+{
+public:
+    CacheServer(int worker_num, Table *table) :
+            Server("127.0.0.1", 6380, SW_MODE_PROCESS), resp(this, table)
+    {
+        serv.worker_num = worker_num;
+        resp.bind(getPort(0));
+    }
+
+    virtual void onStart() {}
+    virtual void onShutdown() {}
+    virtual void onWorkerStart(int worker_id) {}
+    virtual void onWorkerStop(int worker_id) {}
+    virtual void onPipeMessage(int src_worker_id, const DataBuffer &) {}
+    virtual void onReceive(int fd, const DataBuffer &data) {}
+    virtual void onConnect(int fd) {}
+    virtual void onClose(int fd) {}
+    virtual void onPacket(const DataBuffer &data, ClientInfo &clientInfo) {}
+    virtual void onTask(int task_id, int src_worker_id, const DataBuffer &data) {}
+    virtual void onFinish(int task_id, const DataBuffer &data) {}
+
+protected:
+    RespServer resp;
+};
+
+static const int KEY_NUM = 10000;
+static const char VALUE[] = "0123456789abcdef";
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool read_bytes(int sock, size_t length)
+{
+    char buffer[65536];
+    while (length > 0)
+    {
+        ssize_t n = read(sock, buffer, length < sizeof(buffer) ? length : sizeof(buffer));
+        if (n <= 0)
+        {
+            return false;
+        }
+        length -= n;
+    }
+    return true;
+}
+
+static void client_thread(int id, long requests, int pipeline, bool get, atomic<long> *total)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    bzero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(6380);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        printf("connect failed. Error: %s\n", strerror(errno));
+        ::close(sock);
+        return;
+    }
+    int option = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+
+    //+OK for SET, the bulk string of the value for GET
+    char reply[64];
+    size_t reply_length = get ? snprintf(reply, sizeof(reply), "$%d\r\n%s\r\n", (int) sizeof(VALUE) - 1, VALUE) : 5;
+
+    string batch;
+    long done = 0;
+    while (done < requests)
+    {
+        batch.clear();
+        int n = 0;
+        for (; n < pipeline && done + n < requests; n++)
+        {
+            char key[32];
+            int key_length = snprintf(key, sizeof(key), "key:%d", (int) ((id * requests + done + n) % KEY_NUM));
+            char command[128];
+            int length;
+            if (get)
+            {
+                length = snprintf(command, sizeof(command), "*2\r\n$3\r\nGET\r\n$%d\r\n%s\r\n", key_length, key);
+            }
+            else
+            {
+                length = snprintf(command, sizeof(command), "*3\r\n$3\r\nSET\r\n$%d\r\n%s\r\n$%d\r\n%s\r\n", key_length,
+                                  key, (int) sizeof(VALUE) - 1, VALUE);
+            }
+            batch.append(command, length);
+        }
+        if (write(sock, batch.c_str(), batch.length()) != (ssize_t) batch.length() || !read_bytes(sock, reply_length * n))
+        {
+            printf("connection #%d failed.\n", id);
+            break;
+        }
+        done += n;
+    }
+    ::close(sock);
+    *total += done;
+}
+
+static void bench(const char *name, int connections, long requests, int pipeline, bool get)
+{
+    atomic<long> total(0);
+    vector<thread> threads;
+    double start = now();
+    for (int i = 0; i < connections; i++)
+    {
+        threads.push_back(thread(client_thread, i, requests, pipeline, get, &total));
+    }
+    for (auto iter = threads.begin(); iter != threads.end(); iter++)
+    {
+        iter->join();
+    }
+    double cost = now() - start;
+    printf("%s\t%ld requests, %.3f seconds, %.0f requests/s\n", name, total.load(), cost, total.load() / cost);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "server") == 0)
+    {
+        swoole_init();
+        Table table(KEY_NUM * 2);
+        RespServer::defineColumns(table, 64);
+        if (!table.create())
+        {
+            return 1;
+        }
+        CacheServer server(argc > 2 ? atoi(argv[2]) : 4, &table);
+        server.start();
+        return 0;
+    }
+    if (argc < 5)
+    {
+        printf("usage: %s server <worker_num> | client <connections> <requests> <pipeline>\n", argv[0]);
+        return 1;
+    }
+
+    int connections = atoi(argv[2]);
+    long requests = atol(argv[3]);
+    int pipeline = atoi(argv[4]);
+    bench("SET", connections, requests, pipeline, false);
+    bench("GET", connections, requests, pipeline, true);
+    return 0;
+}
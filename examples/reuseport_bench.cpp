@@ -0,0 +1,127 @@
+#include <swoole/Server.hpp>
+#include <netinet/tcp.h>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace swoole;
+
+/**
+ * ./reuseport_bench server <worker_num>
+ * ./reuseport_bench client <connections> <seconds>
+ *
+ * Run the server with 1, 2, 4 ... workers to see requests per second follow the number of cores.
+ */
+class EchoServer : public Server
+{
+public:
+    EchoServer(string _host, int _port, int worker_num) :
+            Server(_host, _port, SW_MODE_SINGLE)
+    {
+        serv.worker_num = worker_num;
+        setReusePort(true);
+    }
+
+    virtual void onStart() {}
+    virtual void onShutdown() {}
+    virtual void onWorkerStart(int worker_id) {}
+    virtual void onWorkerStop(int worker_id) {}
+    virtual void onPipeMessage(int src_worker_id, const DataBuffer &) {}
+    virtual void onConnect(int fd) {}
+    virtual void onClose(int fd) {}
+    virtual void onPacket(const DataBuffer &data, ClientInfo &clientInfo) {}
+    virtual void onTask(int task_id, int src_worker_id, const DataBuffer &data) {}
+    virtual void onFinish(int task_id, const DataBuffer &data) {}
+
+    virtual void onReceive(int fd, const DataBuffer &data)
+    {
+        send(fd, data);
+    }
+};
+
+static const char *HOST = "127.0.0.1";
+static const int PORT = 9501;
+
+static void client_thread(int connections, int seconds, atomic<long> *total)
+{
+    static const char request[] = "ping";
+    char buffer[64];
+    vector<int> socks;
+
+    for (int i = 0; i < connections; i++)
+    {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        bzero(&addr, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(PORT);
+        inet_pton(AF_INET, HOST, &addr.sin_addr);
+        if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        {
+            printf("connect failed. Error: %s\n", strerror(errno));
+            ::close(sock);
+            continue;
+        }
+        int option = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+        socks.push_back(sock);
+    }
+
+    long count = 0;
+    time_t end = time(NULL) + seconds;
+    while (time(NULL) < end)
+    {
+        for (auto sock = socks.begin(); sock != socks.end(); sock++)
+        {
+            if (write(*sock, request, sizeof(request) - 1) <= 0 || read(*sock, buffer, sizeof(buffer)) <= 0)
+            {
+                continue;
+            }
+            count++;
+        }
+    }
+    *total += count;
+    for (auto sock = socks.begin(); sock != socks.end(); sock++)
+    {
+        ::close(*sock);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "server") == 0)
+    {
+        int worker_num = argc > 2 ? atoi(argv[2]) : 4;
+        EchoServer server(HOST, PORT, worker_num);
+        server.setEvents(EVENT_onReceive);
+        server.start();
+    }
+    else if (argc > 1 && strcmp(argv[1], "client") == 0)
+    {
+        int connections = argc > 2 ? atoi(argv[2]) : 64;
+        int seconds = argc > 3 ? atoi(argv[3]) : 10;
+        int thread_num = (int) thread::hardware_concurrency();
+        if (thread_num > connections)
+        {
+            thread_num = connections;
+        }
+
+        atomic<long> total(0);
+        vector<thread> threads;
+        for (int i = 0; i < thread_num; i++)
+        {
+            threads.push_back(thread(client_thread, connections / thread_num, seconds, &total));
+        }
+        for (auto t = threads.begin(); t != threads.end(); t++)
+        {
+            t->join();
+        }
+        printf("requests=%ld, qps=%ld\n", total.load(), total.load() / seconds);
+    }
+    else
+    {
+        printf("usage: %s server <worker_num> | client <connections> <seconds>\n", argv[0]);
+    }
+    return 0;
+}
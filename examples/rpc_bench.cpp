@@ -0,0 +1,167 @@
+#include <swoole/Rpc.hpp>
+#include <sys/time.h>
+#include <iostream>
+
+using namespace std;
+using namespace swoole;
+
+/**
+ * ./rpc_bench server
+ * ./rpc_bench client <requests> <in-flight>
+ *
+ * Method 1 is answered right away, method 2 by a task worker from onFinish, so the
+ * responses of one connection come back out of order.
+ */
+enum
+{
+    METHOD_ECHO = 1,
+    METHOD_TASK = 2,
+};
+
+//in front of the body of a task, to find the request again in onFinish
+struct TaskHeader
+{
+    int fd;
+    uint32_t request_id;
+};
+
+class EchoServer;
+
+class EchoHandler : public RpcHandler
+{
+public:
+    EchoHandler(Server *_server) :
+            RpcHandler(_server)
+    {
+    }
+
+    virtual void onRequest(int fd, uint32_t request_id, uint16_t method, const DataBuffer &data)
+    {
+        if (method == METHOD_ECHO)
+        {
+            respond(fd, request_id, data);
+            return;
+        }
+        //data lives in the callback buffer, build the task aside before it is copied there
+        TaskHeader header = {fd, request_id};
+        string payload((const char *) &header, sizeof(header));
+        payload.append((const char *) data.buffer, data.length);
+        DataBuffer task(payload);
+        if (server->task(task) < 0)
+        {
+            respond(fd, request_id, DataBuffer(), RPC_ERROR);
+        }
+    }
+};
+
+class EchoServer : public Server
+{
+public:
+    EchoServer() :
+            Server("127.0.0.1", 9501, SW_MODE_PROCESS), rpc(this)
+    {
+        serv.worker_num = 2;
+        SwooleG.task_worker_num = 2;
+        rpc.bind(listen("127.0.0.1", 9502, SW_SOCK_TCP));
+    }
+
+    virtual void onStart() {}
+    virtual void onShutdown() {}
+    virtual void onWorkerStart(int worker_id) {}
+    virtual void onWorkerStop(int worker_id) {}
+    virtual void onPipeMessage(int src_worker_id, const DataBuffer &) {}
+    virtual void onReceive(int fd, const DataBuffer &data) {}
+    virtual void onConnect(int fd) {}
+    virtual void onClose(int fd) {}
+    virtual void onPacket(const DataBuffer &data, ClientInfo &clientInfo) {}
+
+    virtual void onTask(int task_id, int src_worker_id, const DataBuffer &data)
+    {
+        DataBuffer result = data;
+        finish(result);
+    }
+
+    virtual void onFinish(int task_id, const DataBuffer &data)
+    {
+        TaskHeader header;
+        memcpy(&header, data.buffer, sizeof(header));
+        DataBuffer body;
+        body.buffer = (char *) data.buffer + sizeof(header);
+        body.length = data.length - sizeof(header);
+        rpc.respond(header.fd, header.request_id, body);
+    }
+
+protected:
+    EchoHandler rpc;
+};
+
+static RpcClient *client;
+static long requests;
+static long sent = 0;
+static long received = 0;
+static long errors = 0;
+static struct timeval start_time;
+
+static void send_request(void);
+
+static void on_response(int status, const DataBuffer &data)
+{
+    received++;
+    if (status != RPC_OK)
+    {
+        errors++;
+    }
+    if (sent < requests)
+    {
+        send_request();
+    }
+    else if (received == requests)
+    {
+        struct timeval end_time;
+        gettimeofday(&end_time, NULL);
+        double seconds = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+        printf("%ld requests, %ld errors, %.3f seconds, %.0f requests/s\n", requests, errors, seconds,
+               requests / seconds);
+        exit(0);
+    }
+}
+
+static void send_request(void)
+{
+    static const char payload[] = "hello world";
+    uint16_t method = sent % 2 ? METHOD_TASK : METHOD_ECHO;
+    sent++;
+    client->call(method, DataBuffer(payload, sizeof(payload) - 1), on_response);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "server") == 0)
+    {
+        EchoServer server;
+        server.setEvents(EVENT_onTask | EVENT_onFinish);
+        server.start();
+        return 0;
+    }
+    if (argc < 4)
+    {
+        printf("usage: %s server | client <requests> <in-flight>\n", argv[0]);
+        return 1;
+    }
+
+    requests = atol(argv[2]);
+    long in_flight = atol(argv[3]);
+    client = new RpcClient("127.0.0.1", 9502);
+    client->setTimeout(5000);
+    if (!client->connect())
+    {
+        return 1;
+    }
+    gettimeofday(&start_time, NULL);
+    for (long i = 0; i < in_flight && sent < requests; i++)
+    {
+        send_request();
+    }
+    event_wait();
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <swoole/Table.hpp>
+#include <sys/wait.h>
+#include <time.h>
+#include <iostream>
+
+using namespace std;
+using namespace swoole;
+
+static const int KEY_NUM = 1000;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(Table &table, int worker_id, long n)
+{
+    char key[32];
+    long value;
+    long found = 0;
+
+    double start = now();
+    for (long i = 0; i < n; i++)
+    {
+        snprintf(key, sizeof(key), "user_%ld", i % KEY_NUM);
+        if (table.get(key, "hits", value))
+        {
+            found++;
+        }
+    }
+    double get_cost = now() - start;
+
+    start = now();
+    for (long i = 0; i < n; i++)
+    {
+        snprintf(key, sizeof(key), "user_%ld", i % KEY_NUM);
+        table.incr(key, "hits");
+    }
+    double incr_cost = now() - start;
+
+    printf("worker#%d\tget: %.1f ns/op\tincr: %.1f ns/op\tfound=%ld\n", worker_id, get_cost * 1e9 / n,
+           incr_cost * 1e9 / n, found);
+}
+
+int main(int argc, char **argv)
+{
+    int worker_num = argc > 1 ? atoi(argv[1]) : 4;
+    long n = argc > 2 ? atol(argv[2]) : 1000000;
+
+    swoole_init();
+
+    Table table(KEY_NUM * 2);
+    table.column("hits", Table::TYPE_INT, 8);
+    table.column("score", Table::TYPE_FLOAT);
+    table.column("name", Table::TYPE_STRING, 32);
+    if (!table.create())
+    {
+        return 1;
+    }
+
+    char key[32];
+    for (int i = 0; i < KEY_NUM; i++)
+    {
+        snprintf(key, sizeof(key), "user_%d", i);
+        table.set(key, "hits", 0L);
+        table.set(key, "name", string(key));
+    }
+
+    //every child process reads and writes the same shared rows
+    for (int i = 0; i < worker_num; i++)
+    {
+        if (fork() == 0)
+        {
+            bench(table, i, n);
+            _exit(0);
+        }
+    }
+    for (int i = 0; i < worker_num; i++)
+    {
+        wait(NULL);
+    }
+
+    long total = 0;
+    table.each([&total](const char *key, TableRow &row)
+    {
+        long hits;
+        if (row.get("hits", hits))
+        {
+            total += hits;
+        }
+        return true;
+    });
+    printf("rows=%ld, total hits=%ld, expect=%ld\n", table.count(), total, worker_num * n);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <swoole/Server.hpp>
+#include <signal.h>
+#include <iostream>
+
+using namespace std;
+using namespace swoole;
+
+/**
+ * ./tasking_check [tasks]
+ *
+ * The worker sends its tasks one after another, each from the onFinish of the one before,
+ * so no more than one is ever queued. With max_tasking set to a few tasks, every one of
+ * them must still be admitted: the count of queued tasks goes down as the task workers take them.
+ */
+static const int MAX_TASKING = 4;
+
+class TaskingServer : public Server
+{
+public:
+    TaskingServer(int _task_num) :
+            Server("127.0.0.1", 9501, SW_MODE_PROCESS), task_num(_task_num), finished(0)
+    {
+        serv.worker_num = 1;
+        SwooleG.task_worker_num = 2;
+        setAdmission(MAX_TASKING, 0, 0);
+    }
+
+    virtual void onStart() {}
+    virtual void onShutdown() {}
+    virtual void onWorkerStop(int worker_id) {}
+    virtual void onReceive(int fd, const DataBuffer &data) {}
+    virtual void onConnect(int fd) {}
+    virtual void onClose(int fd) {}
+    virtual void onPacket(const DataBuffer &data, ClientInfo &clientInfo) {}
+    virtual void onPipeMessage(int src_worker_id, const DataBuffer &) {}
+
+    virtual void onWorkerStart(int worker_id)
+    {
+        if (worker_id == 0)
+        {
+            next();
+        }
+    }
+
+    virtual void onTask(int task_id, int src_worker_id, const DataBuffer &data)
+    {
+        DataBuffer result((char *) data.buffer, data.length);
+        finish(result);
+    }
+
+    virtual void onFinish(int task_id, const DataBuffer &data)
+    {
+        finished++;
+        if (finished < task_num)
+        {
+            next();
+            return;
+        }
+        printf("all %d tasks admitted with max_tasking=%d, tasking_num=%ld\n", task_num, MAX_TASKING,
+               stats().tasking_num);
+        kill(SwooleGS->master_pid, SIGTERM);
+    }
+
+protected:
+    void next()
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "task#%d", finished);
+        DataBuffer data(buf, n);
+        if (task(data) < 0)
+        {
+            printf("task#%d was shed after %d tasks, tasking_num=%ld\n", finished, finished, stats().tasking_num);
+            kill(SwooleGS->master_pid, SIGTERM);
+        }
+    }
+
+    int task_num;
+    int finished;
+};
+
+int main(int argc, char **argv)
+{
+    int task_num = argc > 1 ? atoi(argv[1]) : MAX_TASKING * 8;
+
+    TaskingServer server(task_num);
+    server.setEvents(EVENT_onTask | EVENT_onFinish);
+    server.start();
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_AFFINITY_HPP
+#define SWOOLE_CPP_AFFINITY_HPP
+
+#include "Base.hpp"
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * CPU placement of reactor threads, workers and task workers.
+     * Thread/process N of a role runs on cpus[N % cpus.size()] of that role.
+     */
+    class Affinity
+    {
+    public:
+        enum Role
+        {
+            ROLE_REACTOR = 0,
+            ROLE_WORKER,
+            ROLE_TASK_WORKER,
+            ROLE_NUM,
+        };
+
+        enum Preset
+        {
+            //every thread/process on its own cpu as long as there are enough of them
+            PRESET_SPREAD = 1,
+            //like SPREAD, but the cpus are handed out evenly across the NUMA nodes
+            PRESET_NUMA,
+            //like NUMA, the first cpu of every node is left to interrupts and the kernel
+            PRESET_IRQ,
+        };
+
+        void set(Role role, const vector<int> &cpus)
+        {
+            roles[role] = cpus;
+        }
+
+        const vector<int> &get(Role role) const
+        {
+            return roles[role];
+        }
+
+        bool empty() const
+        {
+            return roles[ROLE_REACTOR].empty() && roles[ROLE_WORKER].empty() && roles[ROLE_TASK_WORKER].empty();
+        }
+
+        int getCpu(Role role, int id) const;
+        int getNode(Role role, int id) const;
+        string toString() const;
+
+        static Affinity preset(Preset preset, int reactor_num, int worker_num, int task_worker_num);
+
+        static int getCpuNum(void);
+        static int getNodeNum(void);
+        static vector<int> getNodeCpus(int node);
+        static int getCpuNode(int cpu);
+        static bool bindCpu(int cpu);
+        /**
+         * Prefer the memory of the node for every later allocation of the current process.
+         */
+        static bool bindProcessMemory(int node);
+        static bool bindMemory(void *addr, size_t length, int node);
+
+    protected:
+        vector<int> roles[ROLE_NUM];
+    };
+}
+#endif //SWOOLE_CPP_AFFINITY_HPP
@@ -0,0 +1,162 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_ARENA_HPP
+#define SWOOLE_CPP_ARENA_HPP
+
+#include "Base.hpp"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Bump-pointer memory, nothing is freed on its own: reset() gives everything back at once.
+     */
+    class Arena
+    {
+    public:
+        Arena(size_t _block_size = SW_CPP_ARENA_BLOCK_SIZE, size_t _keep_size = SW_CPP_ARENA_KEEP_SIZE);
+        ~Arena();
+
+        void *alloc(size_t size, size_t align = alignof(max_align_t))
+        {
+            char *ptr = (char *) (((uintptr_t) cursor + align - 1) & ~(uintptr_t) (align - 1));
+            if (ptr + size <= end)
+            {
+                cursor = ptr + size;
+                return ptr;
+            }
+            return allocSlow(size, align);
+        }
+
+        /**
+         * O(1) unless the arena grew past the keep size, then the extra blocks are freed.
+         */
+        void reset(void);
+
+        size_t getMemorySize()
+        {
+            return memory_size;
+        }
+
+        /**
+         * The arena of the event running on this thread, NULL outside of a callback.
+         */
+        static Arena *current(void);
+
+    protected:
+        struct Block
+        {
+            Block *next;
+            size_t size;
+            char data[0];
+        };
+
+        void *allocSlow(size_t size, size_t align);
+        Block *newBlock(size_t size);
+
+        Block *head;
+        Block *block;
+        char *cursor;
+        char *end;
+        size_t block_size;
+        size_t keep_size;
+        size_t memory_size;
+
+        friend class ArenaScope;
+    };
+
+    /**
+     * Makes Arena::current() available until the end of the scope and resets it then.
+     * Nested scopes share the arena, only the outermost one resets it.
+     */
+    class ArenaScope
+    {
+    public:
+        ArenaScope();
+        ~ArenaScope();
+    };
+
+    /**
+     * STL allocator on an arena, deallocate() is a no-op.
+     * The container must not outlive the callback when it uses Arena::current().
+     */
+    template<typename T>
+    class ArenaAllocator
+    {
+    public:
+        typedef T value_type;
+
+        ArenaAllocator() :
+                arena(Arena::current())
+        {
+        }
+
+        ArenaAllocator(Arena *_arena) :
+                arena(_arena)
+        {
+        }
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) :
+                arena(other.arena)
+        {
+        }
+
+        T *allocate(size_t n)
+        {
+            if (arena == NULL)
+            {
+                return (T *) ::operator new(n * sizeof(T));
+            }
+            return (T *) arena->alloc(n * sizeof(T), alignof(T));
+        }
+
+        void deallocate(T *ptr, size_t n)
+        {
+            //outside of a callback it came from the heap
+            if (arena == NULL)
+            {
+                ::operator delete(ptr);
+            }
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U> &other) const
+        {
+            return arena == other.arena;
+        }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const
+        {
+            return arena != other.arena;
+        }
+
+        Arena *arena;
+    };
+
+    typedef basic_string<char, char_traits<char>, ArenaAllocator<char> > ArenaString;
+
+    template<typename T>
+    using ArenaVector = vector<T, ArenaAllocator<T> >;
+}
+#endif //SWOOLE_CPP_ARENA_HPP
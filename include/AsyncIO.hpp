@@ -0,0 +1,58 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_ASYNC_IO_HPP
+#define SWOOLE_CPP_ASYNC_IO_HPP
+
+#include "Base.hpp"
+
+#include <string>
+#include <functional>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Asynchronous file I/O of the process. With liburing (HAVE_LIBURING) the requests go to an
+     * io_uring, otherwise to a ThreadPool of SW_CPP_AIO_THREAD_NUM threads.
+     * Callbacks run on the reactor of a worker; a process without a reactor (task worker)
+     * runs them in wait().
+     */
+    class AsyncIO
+    {
+    public:
+        //error is an errno, 0 on success
+        typedef function<void(int error, const char *data, size_t length)> ReadCallback;
+        typedef function<void(int error, size_t length)> WriteCallback;
+
+        static bool pread(int fd, size_t length, off_t offset, const ReadCallback &callback);
+        /**
+         * The data is copied, the caller may free it right away.
+         */
+        static bool pwrite(int fd, const void *data, size_t length, off_t offset, const WriteCallback &callback);
+        static bool readFile(const string &file, const ReadCallback &callback);
+        static bool writeFile(const string &file, const void *data, size_t length, const WriteCallback &callback,
+                              int flags = O_WRONLY | O_CREAT | O_TRUNC);
+        /**
+         * Block until every request of the process has called back.
+         */
+        static void wait(void);
+
+        static int onReactorRead(swReactor *reactor, swEvent *event);
+    };
+}
+#endif //SWOOLE_CPP_ASYNC_IO_HPP
@@ -20,8 +20,84 @@
 #include <swoole/config.h>
 #include <swoole/swoole.h>
 
+//max number of messages read from a channel before yielding to the reactor
+#define SW_CPP_CHANNEL_BATCH_NUM     64
+//open files kept by each process for Server::sendfile
+#define SW_CPP_FILE_CACHE_SIZE       1024
+//seconds a cached stat() is trusted
+#define SW_CPP_FILE_CACHE_TTL        2
+//bytes read per send when a range does not end at EOF
+#define SW_CPP_SENDFILE_CHUNK_SIZE   (256 * 1024)
+//memory budget of the static content cache in each process
+#define SW_CPP_STATIC_CACHE_MEMORY   (64 * 1024 * 1024)
+//bigger files are not cached, they go out with sendfile
+#define SW_CPP_STATIC_CACHE_FILE_SIZE (64 * 1024)
+//coroutine frames up to SW_CPP_FRAME_ALIGN * SW_CPP_FRAME_CLASS_NUM bytes are pooled
+#define SW_CPP_FRAME_ALIGN           64
+#define SW_CPP_FRAME_CLASS_NUM       64
+//bytes a coroutine connection may have received and not read yet, past it the connection is closed
+#define SW_CPP_CO_QUEUE_SIZE         (1024 * 1024)
+//shared memory ring of each worker for the Logger
+#define SW_CPP_LOG_RING_SIZE         (1024 * 1024)
+//longest log line, longer ones are truncated
+#define SW_CPP_LOG_LINE_SIZE         1024
+//records per second of one call site before it is suppressed
+#define SW_CPP_LOG_RATE_LIMIT        100
+//bytes the log writer collects before a write()
+#define SW_CPP_LOG_BATCH_SIZE        (64 * 1024)
+//milliseconds the log writer sleeps when all rings are empty
+#define SW_CPP_LOG_FLUSH_INTERVAL    10
+//bytes of spans a process buffers before it appends them to its trace file
+#define SW_CPP_TRACE_BUFFER_SIZE     (64 * 1024)
+//task type flag: a TraceContext is in front of the payload, above the flags of libswoole
+#define SW_CPP_TASK_TRACE            (1u << 10)
+//task type flag: the worker counts the task until its result, a task worker that skips finish() acks it
+#define SW_CPP_TASK_ACK              (1u << 11)
+//seconds a worker waits for the result of a task before it stops counting it
+#define SW_CPP_TASK_RESULT_TIMEOUT   60
+//block size of the per-event arena
+#define SW_CPP_ARENA_BLOCK_SIZE      (64 * 1024)
+//memory the per-event arena keeps between events, the rest is freed on reset
+#define SW_CPP_ARENA_KEEP_SIZE       (1024 * 1024)
+//client IPs the rate limiter can track at the same time
+#define SW_CPP_RATE_LIMIT_IP_ROWS    65536
+//compressed bytes handed to the connection at a time
+#define SW_CPP_COMPRESS_CHUNK_SIZE   (32 * 1024)
+//idle deflate contexts kept per level and encoding
+#define SW_CPP_COMPRESSOR_POOL_SIZE  16
+//entries of the io_uring of AsyncIO
+#define SW_CPP_AIO_QUEUE_DEPTH       256
+//threads of AsyncIO without io_uring
+#define SW_CPP_AIO_THREAD_NUM        4
+//largest RPC frame body accepted by RpcHandler and RpcClient
+#define SW_CPP_RPC_MAX_LENGTH        (2 * 1024 * 1024)
+//milliseconds between the timeout checks of RpcClient
+#define SW_CPP_RPC_TIMER_INTERVAL    100
+//longest RESP command a connection may have buffered, larger bulk strings are refused too
+#define SW_CPP_RESP_MAX_LENGTH       (16 * 1024 * 1024)
+//most arguments of one RESP command
+#define SW_CPP_RESP_MAX_ARGS         (1024 * 1024)
+//replies of a pipeline are sent once they reach this size, and at the end of the input
+#define SW_CPP_RESP_FLUSH_SIZE       (64 * 1024)
+//seconds a worker gets to stop on Server::reload() before it is killed
+#define SW_CPP_RELOAD_TIMEOUT        30
+//seconds the reload helper waits for a daemonized master to publish its pid
+#define SW_CPP_RELOAD_HELPER_GRACE   10
+
+//SwooleG.error when the admission limits of the Server turned work away
+#define SW_CPP_ERROR_SHED            9001
+
 namespace swoole
 {
+    //reactor fd types of the C++ layer
+    enum
+    {
+        FD_CHANNEL = SW_FD_USER + 1,
+        FD_THREAD_POOL,
+        FD_ASYNC_IO,
+        FD_RPC_CLIENT,
+    };
+
     void event_init(void);
     void event_wait(void);
     void check_reactor(void);
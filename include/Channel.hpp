@@ -0,0 +1,95 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_CHANNEL_HPP
+#define SWOOLE_CPP_CHANNEL_HPP
+
+#include "Base.hpp"
+
+namespace swoole
+{
+    /**
+     * Bounded multi-producer/single-consumer ring in shared memory.
+     * Producers never take a lock, the eventfd is only written when the consumer
+     * has declared itself idle, so a busy consumer costs no syscall per message.
+     */
+    class Channel
+    {
+    public:
+        Channel(size_t capacity, size_t slot_size);
+        ~Channel();
+
+        bool push(int src_worker_id, const void *data, size_t length);
+        /**
+         * Zero-copy read of the oldest message, it stays valid until pop().
+         */
+        bool peek(int *src_worker_id, char **data, size_t *length);
+        void pop(void);
+        /**
+         * Called by the consumer before it goes back to the reactor.
+         * Returns false if messages arrived meanwhile and it must keep reading.
+         */
+        bool sleep(void);
+        void notify(void);
+        void clearNotify(void);
+        /**
+         * Move the ring to the NUMA node of its consumer.
+         */
+        bool bindNode(int node);
+
+        int getFd()
+        {
+            return efd;
+        }
+
+        size_t getSlotSize()
+        {
+            return slot_size;
+        }
+
+    protected:
+        struct Header
+        {
+            volatile uint64_t enqueue_pos;
+            char _pad1[64 - sizeof(uint64_t)];
+            volatile uint64_t dequeue_pos;
+            char _pad2[64 - sizeof(uint64_t)];
+            sw_atomic_t waiting;
+        };
+
+        struct Cell
+        {
+            volatile uint64_t sequence;
+            int src_worker_id;
+            uint32_t length;
+            char data[0];
+        };
+
+        Cell *getCell(uint64_t pos)
+        {
+            return (Cell *) (cells + (pos & mask) * cell_size);
+        }
+
+        Header *header;
+        char *cells;
+        size_t mask;
+        size_t slot_size;
+        size_t cell_size;
+        size_t memory_size;
+        int efd;
+    };
+}
+#endif //SWOOLE_CPP_CHANNEL_HPP
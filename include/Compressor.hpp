@@ -0,0 +1,85 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_COMPRESSOR_HPP
+#define SWOOLE_CPP_COMPRESSOR_HPP
+
+#include "Base.hpp"
+
+#include <zlib.h>
+#include <functional>
+
+using namespace std;
+
+namespace swoole
+{
+    enum CompressEncoding
+    {
+        ENCODING_GZIP,
+        //zlib stream, what HTTP calls deflate
+        ENCODING_DEFLATE,
+    };
+
+    /**
+     * Deflates into a fixed buffer of SW_CPP_COMPRESS_CHUNK_SIZE and hands every full chunk to output,
+     * memory does not grow with the size of the data. The z_stream comes from a pool of the thread
+     * and goes back on end() or destruction.
+     */
+    class CompressStream
+    {
+    public:
+        typedef function<bool(const char *data, size_t length)> Output;
+
+        CompressStream(const Output &_output, int level = Z_DEFAULT_COMPRESSION,
+                       CompressEncoding encoding = ENCODING_GZIP);
+        ~CompressStream();
+
+        bool write(const void *data, size_t length);
+        bool end(void);
+
+        size_t getInputBytes()
+        {
+            return input_bytes;
+        }
+
+        size_t getOutputBytes()
+        {
+            return output_bytes;
+        }
+
+    protected:
+        bool deflateTo(int flush);
+        void release(void);
+
+        Output output;
+        z_stream *stream;
+        int pool_index;
+        size_t input_bytes;
+        size_t output_bytes;
+    };
+
+    /**
+     * Deflate contexts kept for reuse by each thread, one list per level and encoding, so a response
+     * costs a deflateReset() instead of a deflateInit2() with its 256KB of allocations.
+     */
+    class CompressorPool
+    {
+    public:
+        static z_stream *acquire(int level, CompressEncoding encoding, int *index);
+        static void release(z_stream *stream, int index);
+    };
+}
+#endif //SWOOLE_CPP_COMPRESSOR_HPP
@@ -0,0 +1,171 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_CONTEXT_HPP
+#define SWOOLE_CPP_CONTEXT_HPP
+
+#include "Base.hpp"
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace swoole
+{
+    class ContextStore
+    {
+    public:
+        virtual ~ContextStore()
+        {};
+
+        virtual void create(int index, int session_id) = 0;
+        virtual void destroy(int index, int session_id) = 0;
+    };
+
+    /**
+     * Per-connection objects of type T, stored in a flat array indexed by the
+     * socket fd of the connection. Objects are carved out of fixed-size chunks
+     * and recycled through a free list, so connection churn does not malloc.
+     */
+    template<typename T>
+    class ConnectionContext : public ContextStore
+    {
+    public:
+        ConnectionContext(size_t _chunk_size = 256)
+        {
+            chunk_size = _chunk_size;
+            free_list = NULL;
+        }
+
+        ~ConnectionContext()
+        {
+            for (size_t i = 0; i < slots.size(); i++)
+            {
+                if (slots[i].object)
+                {
+                    slots[i].object->~T();
+                }
+            }
+            for (size_t i = 0; i < chunks.size(); i++)
+            {
+                sw_free(chunks[i]);
+            }
+        }
+
+        T *get(int index, int session_id)
+        {
+            if (index < 0 || (size_t) index >= slots.size() || slots[index].session_id != session_id)
+            {
+                return NULL;
+            }
+            return slots[index].object;
+        }
+
+        void create(int index, int session_id)
+        {
+            if (index < 0)
+            {
+                return;
+            }
+            //the array is allocated in the worker process on first use
+            if ((size_t) index >= slots.size())
+            {
+                slots.resize(max((size_t) index + 1, max(slots.size() * 2, (size_t) 1024)));
+            }
+            Slot *slot = &slots[index];
+            if (slot->object)
+            {
+                release(slot);
+            }
+            void *mem = alloc();
+            if (mem == NULL)
+            {
+                return;
+            }
+            slot->object = new(mem) T();
+            slot->session_id = session_id;
+        }
+
+        void destroy(int index, int session_id)
+        {
+            if (index < 0 || (size_t) index >= slots.size() || slots[index].session_id != session_id)
+            {
+                return;
+            }
+            release(&slots[index]);
+        }
+
+    protected:
+        struct Slot
+        {
+            int session_id;
+            T *object;
+
+            Slot()
+            {
+                session_id = 0;
+                object = NULL;
+            }
+        };
+
+        union Node
+        {
+            Node *next;
+            typename aligned_storage<sizeof(T), alignof(T)>::type data;
+        };
+
+        void *alloc()
+        {
+            if (free_list == NULL)
+            {
+                Node *chunk = (Node *) sw_malloc(sizeof(Node) * chunk_size);
+                if (chunk == NULL)
+                {
+                    swWarn("malloc(%ld) failed.", sizeof(Node) * chunk_size);
+                    return NULL;
+                }
+                chunks.push_back(chunk);
+                for (size_t i = 0; i < chunk_size; i++)
+                {
+                    chunk[i].next = free_list;
+                    free_list = &chunk[i];
+                }
+            }
+            Node *node = free_list;
+            free_list = node->next;
+            return node;
+        }
+
+        void release(Slot *slot)
+        {
+            slot->object->~T();
+            Node *node = (Node *) slot->object;
+            node->next = free_list;
+            free_list = node;
+            slot->object = NULL;
+            slot->session_id = 0;
+        }
+
+        size_t chunk_size;
+        vector<Slot> slots;
+        vector<void *> chunks;
+        Node *free_list;
+    };
+}
+#endif //SWOOLE_CPP_CONTEXT_HPP
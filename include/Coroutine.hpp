@@ -0,0 +1,459 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_COROUTINE_HPP
+#define SWOOLE_CPP_COROUTINE_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#error "Coroutine.hpp requires C++20 (-std=c++20)"
+#endif
+
+#include "Server.hpp"
+#include "Timer.hpp"
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <unordered_map>
+
+namespace swoole
+{
+    /**
+     * Free lists of coroutine frames by size class, frames are recycled instead of freed.
+     * A worker runs all its coroutines on the reactor thread, so no locking.
+     */
+    class FramePool
+    {
+    public:
+        static void *alloc(size_t size)
+        {
+            size_t index = (size + SW_CPP_FRAME_ALIGN - 1) / SW_CPP_FRAME_ALIGN;
+            if (index >= SW_CPP_FRAME_CLASS_NUM)
+            {
+                return ::operator new(size);
+            }
+            Node *node = free_list[index];
+            if (node)
+            {
+                free_list[index] = node->next;
+                return node;
+            }
+            return ::operator new(index * SW_CPP_FRAME_ALIGN);
+        }
+
+        static void free(void *ptr, size_t size)
+        {
+            size_t index = (size + SW_CPP_FRAME_ALIGN - 1) / SW_CPP_FRAME_ALIGN;
+            if (index >= SW_CPP_FRAME_CLASS_NUM)
+            {
+                ::operator delete(ptr);
+                return;
+            }
+            Node *node = (Node *) ptr;
+            node->next = free_list[index];
+            free_list[index] = node;
+        }
+
+    protected:
+        struct Node
+        {
+            Node *next;
+        };
+
+        static inline Node *free_list[SW_CPP_FRAME_CLASS_NUM] = {};
+    };
+
+    /**
+     * A detached coroutine: it starts immediately and destroys itself when it returns.
+     */
+    struct Task
+    {
+        struct promise_type
+        {
+            Task get_return_object()
+            {
+                return Task();
+            }
+
+            std::suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void()
+            {
+            }
+
+            void unhandled_exception()
+            {
+                swWarn("uncaught exception in coroutine.");
+                std::terminate();
+            }
+
+            static void *operator new(size_t size)
+            {
+                return FramePool::alloc(size);
+            }
+
+            static void operator delete(void *ptr, size_t size)
+            {
+                FramePool::free(ptr, size);
+            }
+        };
+    };
+
+    /**
+     * Server whose connections are handled by one coroutine each.
+     * onConnection() starts on connect and reads with co_await recv(fd), which
+     * returns an empty string once the connection is closed.
+     * A connection that buffers more than SW_CPP_CO_QUEUE_SIZE unread bytes is closed.
+     */
+    class CoServer : public Server
+    {
+    protected:
+        struct Connection
+        {
+            std::deque<string> queue;
+            size_t queue_bytes = 0;
+            std::coroutine_handle<> waiter;
+            string *result;
+            //suspended in sleep(fd, ms) or task(fd, data), resumed early by onClose
+            std::coroutine_handle<> sleeper;
+            int task_id = -1;
+            bool closed = false;
+        };
+
+        struct TaskWaiter
+        {
+            std::coroutine_handle<> handle;
+            string *result;
+        };
+
+        bool isOpen(int fd)
+        {
+            Connection *conn = getConnection(fd);
+            return conn != NULL && !conn->closed;
+        }
+
+        /**
+         * Bind a coroutine suspended outside recv() to its open connection,
+         * one per connection, a second one is only resumed by its timer or task.
+         */
+        void bindSleeper(int fd, std::coroutine_handle<> handle, int task_id = -1)
+        {
+            Connection *conn = getConnection(fd);
+            if (conn && !conn->sleeper)
+            {
+                conn->sleeper = handle;
+                conn->task_id = task_id;
+            }
+        }
+
+        /**
+         * Unbind it on resume, false if the connection has been closed meanwhile.
+         */
+        bool unbindSleeper(int fd, std::coroutine_handle<> handle)
+        {
+            Connection *conn = getConnection(fd);
+            if (conn == NULL)
+            {
+                return false;
+            }
+            if (conn->sleeper == handle)
+            {
+                conn->sleeper = nullptr;
+                conn->task_id = -1;
+            }
+            return !conn->closed;
+        }
+
+        class ResumeTimer : public Timer
+        {
+        public:
+            ResumeTimer(long ms, std::coroutine_handle<> _handle) :
+                    Timer(ms, false), handle(_handle)
+            {
+            }
+
+        protected:
+            virtual void callback(void)
+            {
+                handle.resume();
+            }
+
+            std::coroutine_handle<> handle;
+        };
+
+    public:
+        CoServer(string _host, int _port, int _mode = SW_MODE_PROCESS, int _type = SW_SOCK_TCP) :
+                Server(_host, _port, _mode, _type)
+        {
+        }
+
+        virtual Task onConnection(int fd) = 0;
+
+        struct RecvAwaiter
+        {
+            CoServer *server;
+            int fd;
+            Connection *conn;
+            string result;
+
+            bool await_ready()
+            {
+                conn = server->getConnection(fd);
+                if (conn == NULL)
+                {
+                    return true;
+                }
+                if (!conn->queue.empty())
+                {
+                    result = std::move(conn->queue.front());
+                    conn->queue.pop_front();
+                    conn->queue_bytes -= result.length();
+                    return true;
+                }
+                return conn->closed;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                conn->waiter = handle;
+                conn->result = &result;
+            }
+
+            string await_resume()
+            {
+                return std::move(result);
+            }
+        };
+
+        struct SleepAwaiter
+        {
+            CoServer *server;
+            int fd;
+            long ms;
+            std::optional<ResumeTimer> timer;
+            std::coroutine_handle<> handle;
+
+            bool await_ready()
+            {
+                return ms <= 0;
+            }
+
+            bool await_suspend(std::coroutine_handle<> _handle)
+            {
+                handle = _handle;
+                if (fd >= 0)
+                {
+                    if (!server->isOpen(fd))
+                    {
+                        return false;
+                    }
+                    server->bindSleeper(fd, handle);
+                }
+                timer.emplace(ms, handle);
+                return true;
+            }
+
+            //false if the connection is closed, the timer is cancelled when the awaiter goes
+            bool await_resume()
+            {
+                return fd < 0 || server->unbindSleeper(fd, handle);
+            }
+        };
+
+        struct TaskAwaiter
+        {
+            CoServer *server;
+            int fd;
+            DataBuffer data;
+            string result;
+            std::coroutine_handle<> handle;
+
+            bool await_ready()
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> _handle)
+            {
+                handle = _handle;
+                if (fd >= 0 && !server->isOpen(fd))
+                {
+                    return false;
+                }
+                int task_id = server->Server::task(data);
+                if (task_id < 0)
+                {
+                    return false;
+                }
+                server->task_waiters[task_id] = {handle, &result};
+                if (fd >= 0)
+                {
+                    server->bindSleeper(fd, handle, task_id);
+                }
+                return true;
+            }
+
+            string await_resume()
+            {
+                if (fd >= 0)
+                {
+                    server->unbindSleeper(fd, handle);
+                }
+                return std::move(result);
+            }
+        };
+
+        RecvAwaiter recv(int fd)
+        {
+            return RecvAwaiter{this, fd, NULL, string()};
+        }
+
+        SleepAwaiter sleep(long ms)
+        {
+            return SleepAwaiter{this, -1, ms, std::nullopt, nullptr};
+        }
+
+        /**
+         * Also resumed when connection fd is closed, co_await returns false then.
+         */
+        SleepAwaiter sleep(int fd, long ms)
+        {
+            return SleepAwaiter{this, fd, ms, std::nullopt, nullptr};
+        }
+
+        /**
+         * Dispatch to a task worker and resume with the data it finished with.
+         * The result is empty if the task ended without finish() or was dropped by onTaskDropped.
+         */
+        TaskAwaiter task(const DataBuffer &data)
+        {
+            return TaskAwaiter{this, -1, data, string(), nullptr};
+        }
+
+        /**
+         * Also resumed with an empty result when connection fd is closed, a late result is discarded.
+         */
+        TaskAwaiter task(int fd, const DataBuffer &data)
+        {
+            return TaskAwaiter{this, fd, data, string(), nullptr};
+        }
+
+        virtual void onConnect(int fd)
+        {
+            connections.create(getConnectionIndex(fd), fd);
+            onConnection(fd);
+        }
+
+        virtual void onReceive(int fd, const DataBuffer &data)
+        {
+            Connection *conn = getConnection(fd);
+            if (conn == NULL)
+            {
+                return;
+            }
+            if (conn->waiter)
+            {
+                std::coroutine_handle<> handle = conn->waiter;
+                conn->waiter = nullptr;
+                conn->result->assign((char *) data.buffer, data.length);
+                handle.resume();
+            }
+            else if (conn->queue_bytes + data.length > SW_CPP_CO_QUEUE_SIZE)
+            {
+                swWarn("connection#%d has %lu unread bytes, closed.", fd, (unsigned long) conn->queue_bytes);
+                close(fd);
+            }
+            else
+            {
+                conn->queue.emplace_back((char *) data.buffer, data.length);
+                conn->queue_bytes += data.length;
+            }
+        }
+
+        virtual void onClose(int fd)
+        {
+            Connection *conn = getConnection(fd);
+            if (conn == NULL)
+            {
+                return;
+            }
+            conn->closed = true;
+            if (conn->waiter)
+            {
+                std::coroutine_handle<> handle = conn->waiter;
+                conn->waiter = nullptr;
+                handle.resume();
+            }
+            //the coroutine may have gone on to sleep or wait for a task
+            if (conn->sleeper)
+            {
+                std::coroutine_handle<> handle = conn->sleeper;
+                if (conn->task_id >= 0)
+                {
+                    task_waiters.erase(conn->task_id);
+                }
+                conn->sleeper = nullptr;
+                conn->task_id = -1;
+                handle.resume();
+            }
+            connections.destroy(getConnectionIndex(fd), fd);
+        }
+
+        virtual void onFinish(int task_id, const DataBuffer &data)
+        {
+            auto iter = task_waiters.find(task_id);
+            if (iter == task_waiters.end())
+            {
+                return;
+            }
+            TaskWaiter waiter = iter->second;
+            task_waiters.erase(iter);
+            waiter.result->assign((char *) data.buffer, data.length);
+            waiter.handle.resume();
+        }
+
+        virtual void onTaskDropped(int task_id)
+        {
+            auto iter = task_waiters.find(task_id);
+            if (iter == task_waiters.end())
+            {
+                return;
+            }
+            TaskWaiter waiter = iter->second;
+            task_waiters.erase(iter);
+            waiter.handle.resume();
+        }
+
+    protected:
+        Connection *getConnection(int fd)
+        {
+            return connections.get(getConnectionIndex(fd), fd);
+        }
+
+        ConnectionContext<Connection> connections;
+        std::unordered_map<int, TaskWaiter> task_waiters;
+    };
+}
+#endif //SWOOLE_CPP_COROUTINE_HPP
@@ -0,0 +1,71 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_FILE_CACHE_HPP
+#define SWOOLE_CPP_FILE_CACHE_HPP
+
+#include "Base.hpp"
+
+#include <sys/stat.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * LRU cache of open file descriptors and their stat(), per process.
+     * An entry is trusted for ttl seconds, then it is checked again with stat()
+     * and reopened if the file was replaced or modified.
+     */
+    class FileCache
+    {
+    public:
+        struct File
+        {
+            string path;
+            int fd;
+            struct stat info;
+            time_t expire;
+        };
+
+        FileCache(size_t _max_files = SW_CPP_FILE_CACHE_SIZE, int _ttl = SW_CPP_FILE_CACHE_TTL)
+        {
+            max_files = _max_files;
+            ttl = _ttl;
+        }
+
+        ~FileCache()
+        {
+            clear();
+        }
+
+        File *get(const string &path);
+        void remove(const string &path);
+        void clear(void);
+
+    protected:
+        bool open(File *file);
+
+        size_t max_files;
+        int ttl;
+        list<File> lru;
+        unordered_map<string, list<File>::iterator> index;
+    };
+}
+#endif //SWOOLE_CPP_FILE_CACHE_HPP
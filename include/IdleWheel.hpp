@@ -0,0 +1,80 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_IDLE_WHEEL_HPP
+#define SWOOLE_CPP_IDLE_WHEEL_HPP
+
+#include "Base.hpp"
+#include "Timer.hpp"
+
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Closes the connections of a worker that have been idle for timeout seconds.
+     * A connection sits in the slot of the second it expires, traffic only updates its
+     * last active time. When the slot comes round, a connection that was active meanwhile
+     * moves to its new slot, the others are closed in one batch.
+     */
+    class IdleWheel : public Timer
+    {
+    public:
+        typedef function<void(int session_id)> CloseHandler;
+
+        IdleWheel(int _timeout, const CloseHandler &_onIdle);
+
+        void add(int index, int session_id);
+
+        void touch(int index)
+        {
+            if ((size_t) index < last_active.size())
+            {
+                last_active[index] = now;
+            }
+        }
+
+        void remove(int index)
+        {
+            if ((size_t) index < sessions.size())
+            {
+                sessions[index] = 0;
+            }
+        }
+
+    protected:
+        struct Entry
+        {
+            int index;
+            int session_id;
+        };
+
+        virtual void callback(void);
+
+        int timeout;
+        uint32_t now;
+        //by the connection index, 0 is a free slot
+        vector<int> sessions;
+        vector<uint32_t> last_active;
+        vector<vector<Entry> > slots;
+        vector<int> expired;
+        CloseHandler onIdle;
+    };
+}
+#endif //SWOOLE_CPP_IDLE_WHEEL_HPP
@@ -0,0 +1,107 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_LISTEN_PORT_HPP
+#define SWOOLE_CPP_LISTEN_PORT_HPP
+
+#include "Base.hpp"
+#include <swoole/Server.h>
+
+#include <string>
+
+using namespace std;
+
+namespace swoole
+{
+    struct DataBuffer;
+    struct ClientInfo;
+
+    /**
+     * Protocol of one listening port. The events of its connections go here
+     * instead of the callbacks of the Server.
+     */
+    class PortHandler
+    {
+    public:
+        virtual ~PortHandler()
+        {
+        }
+
+        virtual void onReceive(int fd, const DataBuffer &data) = 0;
+
+        virtual void onConnect(int fd)
+        {};
+
+        virtual void onClose(int fd)
+        {};
+
+        virtual void onPacket(const DataBuffer &data, ClientInfo &clientInfo)
+        {};
+    };
+
+    /**
+     * Handle of a port returned by Server::listen(), it must be set up before Server::start().
+     */
+    class ListenPort
+    {
+    public:
+        ListenPort(swListenPort *_ls) :
+                ls(_ls), handler(NULL)
+        {
+        }
+
+        void setHandler(PortHandler *_handler)
+        {
+            handler = _handler;
+        }
+
+        PortHandler *getHandler()
+        {
+            return handler;
+        }
+
+        /**
+         * Deliver whole packages with a length field of length_type (pack() format: n, N, v, V, c, C, s, S, l, L)
+         * at length_offset, the body starts at body_offset.
+         */
+        bool setLengthCheck(char length_type, uint16_t length_offset, uint16_t body_offset, uint32_t max_length);
+        /**
+         * Deliver whole packages ending with eof.
+         */
+        bool setEofCheck(const string &eof, uint32_t max_length);
+        void setTcpNodelay(bool enable);
+
+        int getPort()
+        {
+            return ls->port;
+        }
+
+        int getSocket()
+        {
+            return ls->sock;
+        }
+
+        swListenPort *get()
+        {
+            return ls;
+        }
+
+    protected:
+        swListenPort *ls;
+        PortHandler *handler;
+    };
+}
+#endif //SWOOLE_CPP_LISTEN_PORT_HPP
@@ -0,0 +1,167 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_LOGGER_HPP
+#define SWOOLE_CPP_LOGGER_HPP
+
+#include "Base.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <time.h>
+#include <stdarg.h>
+
+using namespace std;
+
+/**
+ * Log with the rate limit of this call site, e.g. SW_CPP_LOG(logger, SW_LOG_WARNING, "fd=%d", fd).
+ */
+#define SW_CPP_LOG(logger, level, format, ...) \
+    do { \
+        static thread_local swoole::LogSite __sw_log_site = {__FILE__, __LINE__, 0, 0, 0}; \
+        (logger).log(&__sw_log_site, level, format, ##__VA_ARGS__); \
+    } while (0)
+
+namespace swoole
+{
+    enum LogOverflowPolicy
+    {
+        //drop the new record, the writer reports how many were lost
+        LOG_OVERFLOW_DROP,
+        //wait until the writer has made room
+        LOG_OVERFLOW_BLOCK,
+        //bypass the ring and write the record to the file directly
+        LOG_OVERFLOW_SYNC,
+    };
+
+    struct LogSite
+    {
+        const char *file;
+        int line;
+        time_t second;
+        uint32_t count;
+        uint32_t suppressed;
+    };
+
+    /**
+     * Asynchronous logger. Every worker formats its records into its own shared memory ring
+     * and a writer thread in the master drains all rings to the file in batches.
+     * Timestamps and level names are only formatted by the writer.
+     * Processes without a ring (master, manager) write synchronously.
+     */
+    class Logger
+    {
+    public:
+        Logger(string _file, size_t _ring_size = SW_CPP_LOG_RING_SIZE);
+        ~Logger();
+
+        /**
+         * Allocate one ring per worker, must be called before the workers are started.
+         */
+        bool create(int ring_num);
+        bool start(void);
+        void stop(void);
+
+        void log(int level, const char *format, ...);
+        void log(LogSite *site, int level, const char *format, ...);
+
+        void setLevel(int _level)
+        {
+            level = _level;
+        }
+
+        void setOverflowPolicy(LogOverflowPolicy _policy)
+        {
+            policy = _policy;
+        }
+
+        void setRateLimit(uint32_t _rate_limit)
+        {
+            rate_limit = _rate_limit;
+        }
+
+    protected:
+        struct Ring
+        {
+            volatile uint64_t write_pos;
+            char _pad1[64 - sizeof(uint64_t)];
+            volatile uint64_t read_pos;
+            char _pad2[64 - sizeof(uint64_t)];
+            //the threads of one worker share its ring
+            sw_atomic_t lock;
+            sw_atomic_long_t dropped;
+            char data[0];
+        };
+
+        struct Record
+        {
+            uint32_t length;
+            uint8_t level;
+            uint8_t type;
+            uint16_t text_length;
+            int64_t usec;
+            char text[0];
+        };
+
+        enum
+        {
+            RECORD_TEXT,
+            RECORD_PAD,
+        };
+
+        struct TimeCache
+        {
+            time_t second;
+            char str[32];
+        };
+
+        void vlog(int level, const char *format, va_list args);
+        bool push(Ring *ring, int level, const char *text, size_t length);
+        void writeSync(int level, const char *text, size_t length);
+        void format(TimeCache &cache, string &out, int level, int64_t usec, int worker_id, const char *text,
+                    size_t length);
+        bool drain(int worker_id, Ring *ring, string &batch);
+        void flush(string &batch);
+        void run(void);
+
+        Ring *getRing(int worker_id)
+        {
+            return (Ring *) (memory + worker_id * (sizeof(Ring) + ring_size));
+        }
+
+        string file;
+        int fd;
+        int level;
+        LogOverflowPolicy policy;
+        uint32_t rate_limit;
+
+        char *memory;
+        size_t ring_size;
+        int ring_num;
+
+        thread writer;
+        atomic<bool> running;
+        mutex sync_lock;
+
+        //formatted second of the writer thread and of the synchronous writes
+        TimeCache writer_time;
+        TimeCache sync_time;
+    };
+}
+#endif //SWOOLE_CPP_LOGGER_HPP
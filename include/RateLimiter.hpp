@@ -0,0 +1,82 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_RATE_LIMITER_HPP
+#define SWOOLE_CPP_RATE_LIMITER_HPP
+
+#include "Base.hpp"
+#include "Table.hpp"
+#include <swoole/Server.h>
+
+#include <vector>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Token buckets per connection and per client IP, checked by the reactor on every TCP message
+     * it has read, before the message is sent to a worker. One message costs one token.
+     * A connection that runs out of tokens is closed: discarding bytes would break the framing of the stream.
+     * The IP buckets live in a shared memory Table, so every process sees the same count.
+     * When the table is full, the rows of IPs whose bucket has refilled are removed.
+     */
+    class RateLimiter
+    {
+    public:
+        RateLimiter(size_t ip_rows = SW_CPP_RATE_LIMIT_IP_ROWS);
+        ~RateLimiter();
+
+        /**
+         * rate events per second, bursts up to burst events. 0 turns the limit off.
+         */
+        void setConnectionLimit(double rate, double burst);
+        void setIpLimit(double rate, double burst);
+
+        /**
+         * Must be called before the server starts.
+         */
+        bool create(size_t max_connection);
+        bool allow(swConnection *conn);
+
+        long getRejected()
+        {
+            return *rejected;
+        }
+
+    protected:
+        struct Bucket
+        {
+            int session_id;
+            double tokens;
+            double stamp;
+        };
+
+        bool allowIp(swConnection *conn, double now);
+        void expireIps(double now);
+
+        double conn_rate;
+        double conn_burst;
+        double ip_rate;
+        double ip_burst;
+
+        //by socket fd, each fd is only read by one reactor thread
+        vector<Bucket> buckets;
+        Table ips;
+        sw_atomic_long_t *rejected;
+    };
+}
+#endif //SWOOLE_CPP_RATE_LIMITER_HPP
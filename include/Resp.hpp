@@ -0,0 +1,150 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+
+#ifndef SWOOLE_CPP_RESP_HPP
+#define SWOOLE_CPP_RESP_HPP
+
+#include "Server.hpp"
+#include "ListenPort.hpp"
+#include "Table.hpp"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * An argument of a command, it points into the received data and is only valid during the command.
+     */
+    struct RespSlice
+    {
+        const char *data;
+        size_t length;
+
+        string str() const
+        {
+            return string(data, length);
+        }
+    };
+
+    /**
+     * Encodes the replies of the commands of one pipeline into one buffer.
+     */
+    class RespReply
+    {
+    public:
+        void status(const char *str);
+        void error(const char *str);
+        void integer(long value);
+        void bulk(const char *data, size_t length);
+        void null(void);
+        void array(size_t num);
+
+        void bulk(const string &str)
+        {
+            bulk(str.c_str(), str.length());
+        }
+
+        const string &buffer()
+        {
+            return out;
+        }
+
+        void clear()
+        {
+            out.clear();
+        }
+
+    protected:
+        string out;
+    };
+
+    /**
+     * Redis protocol on a port of the Server, standard clients and pipelines work against it.
+     * Commands are parsed in place from the received data, only the incomplete tail of a connection
+     * is kept until more arrives. The replies of everything parsed from one receive go out in one send.
+     * With a Table (see defineColumns) it serves PING, ECHO, GET, SET, MGET, DEL, EXISTS,
+     * INCR, INCRBY, DECR, DECRBY and DBSIZE, setCommand() adds or replaces commands.
+     * A connection must always be dispatched to the same worker (dispatch_mode 2 or 4).
+     */
+    class RespServer : public PortHandler
+    {
+    public:
+        typedef function<void(int fd, const vector<RespSlice> &argv, RespReply &reply)> Command;
+
+        RespServer(Server *_server, Table *_table = NULL);
+
+        /**
+         * Columns of the cache, before Table::create().
+         */
+        static bool defineColumns(Table &table, size_t value_size);
+
+        /**
+         * Handle the connections of the port, before Server::start().
+         */
+        bool bind(ListenPort *port);
+        /**
+         * arity counts the command name as Redis does: exactly arity arguments, or at least -arity when negative.
+         */
+        void setCommand(const string &name, int arity, const Command &command);
+
+        void onReceive(int fd, const DataBuffer &data);
+        void onConnect(int fd);
+        void onClose(int fd);
+
+        /**
+         * Bytes of the command at data and its arguments, 0 while it is incomplete, -1 on a protocol error.
+         */
+        static ssize_t parse(const char *data, size_t length, vector<RespSlice> &argv);
+
+    protected:
+        struct CommandEntry
+        {
+            int arity;
+            Command handler;
+        };
+
+        bool execute(int fd);
+        void flush(int fd);
+        void defineCacheCommands(void);
+        void getValue(const RespSlice &key, RespReply &reply);
+        void incrValue(const RespSlice &key, long incrby, RespReply &reply);
+        void incrArgument(const RespSlice &key, const RespSlice &arg, bool negative, RespReply &reply);
+
+        //the table takes string keys, one buffer serves all of them
+        const string &toKey(const RespSlice &slice)
+        {
+            key.assign(slice.data, slice.length);
+            return key;
+        }
+
+        Server *server;
+        Table *table;
+        unordered_map<string, CommandEntry> commands;
+        //incomplete command of each connection, by the connection index
+        vector<string> buffers;
+        vector<RespSlice> argv;
+        RespReply reply;
+        string name;
+        string key;
+    };
+}
+#endif //SWOOLE_CPP_RESP_HPP
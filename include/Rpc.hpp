@@ -0,0 +1,176 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+
+#ifndef SWOOLE_CPP_RPC_HPP
+#define SWOOLE_CPP_RPC_HPP
+
+#include "Server.hpp"
+#include "ListenPort.hpp"
+#include "Timer.hpp"
+
+#include <string>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Frame header of the RPC protocol, every field in network byte order.
+     * length is the size of the body that follows the header.
+     */
+    struct RpcHeader
+    {
+        uint32_t length;
+        uint32_t request_id;
+        uint16_t method;
+        uint16_t status;
+    };
+
+    enum RpcStatus
+    {
+        RPC_OK = 0,
+        RPC_ERROR = 1,
+        //set by RpcClient, never sent by the server
+        RPC_TIMEOUT = 0xfffe,
+        RPC_CLOSED = 0xffff,
+    };
+
+    /**
+     * Server side of the RPC protocol on a port of its own. Requests of one connection are
+     * handed over as they arrive and can be answered in any order, later on as well,
+     * e.g. from onFinish with the fd and request_id carried in the task.
+     */
+    class RpcHandler : public PortHandler
+    {
+    public:
+        RpcHandler(Server *_server) :
+                server(_server)
+        {
+        }
+
+        /**
+         * Set up the framing of the port and handle its connections, before Server::start().
+         */
+        bool bind(ListenPort *port, uint32_t max_length = SW_CPP_RPC_MAX_LENGTH);
+        bool respond(int fd, uint32_t request_id, const DataBuffer &data, uint16_t status = RPC_OK);
+
+        virtual void onRequest(int fd, uint32_t request_id, uint16_t method, const DataBuffer &data) = 0;
+        void onReceive(int fd, const DataBuffer &data);
+
+    protected:
+        Server *server;
+    };
+
+    /**
+     * Client of the RPC protocol on the reactor of the process. Calls are pipelined on the
+     * connection, the pending table matches responses to callbacks by request_id.
+     * It must not be deleted from its own callbacks.
+     */
+    class RpcClient
+    {
+    public:
+        //data is only valid inside the callback
+        typedef function<void(int status, const DataBuffer &data)> Callback;
+
+        RpcClient(const string &_host, int _port);
+        ~RpcClient();
+
+        bool connect(double timeout = 1.0);
+        /**
+         * Returns the request_id, 0 if the client is not connected.
+         * Requests queued in the same event loop round go out in one write.
+         */
+        uint32_t call(uint16_t method, const DataBuffer &data, const Callback &callback);
+        /**
+         * Calls without a response after msec fail with RPC_TIMEOUT, 0 waits forever.
+         */
+        void setTimeout(int msec);
+        /**
+         * Responses with a larger body close the connection, like max_length of RpcHandler::bind().
+         */
+        void setMaxLength(uint32_t length)
+        {
+            max_length = length;
+        }
+        /**
+         * Fails the pending calls with RPC_CLOSED.
+         */
+        void close();
+
+        size_t getPendingNum()
+        {
+            return pending.size();
+        }
+
+        bool isConnected()
+        {
+            return fd >= 0;
+        }
+
+        static int onReactorRead(swReactor *reactor, swEvent *event);
+        static int onReactorWrite(swReactor *reactor, swEvent *event);
+
+    protected:
+        struct Deadline
+        {
+            uint32_t request_id;
+            uint64_t tick;
+        };
+
+        class ExpireTimer : public Timer
+        {
+        public:
+            ExpireTimer(RpcClient *_client) :
+                    Timer(SW_CPP_RPC_TIMER_INTERVAL, true), client(_client)
+            {
+            }
+
+        protected:
+            virtual void callback(void)
+            {
+                client->expire();
+            }
+
+            RpcClient *client;
+        };
+
+        bool read(void);
+        bool write(void);
+        void expire(void);
+
+        string host;
+        int port;
+        int fd;
+        //goes up with every close(), a callback may close and connect again
+        uint32_t generation;
+        uint32_t max_length;
+        uint32_t next_id;
+        int timeout;
+        uint64_t ticks;
+        unordered_map<uint32_t, Callback> pending;
+        //in the order of the calls, so of their deadlines too
+        deque<Deadline> deadlines;
+        string send_buffer;
+        size_t send_offset;
+        string recv_buffer;
+        ExpireTimer *timer;
+    };
+}
+#endif //SWOOLE_CPP_RPC_HPP
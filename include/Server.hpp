@@ -20,8 +20,21 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 
 #include "Base.hpp"
+#include "Context.hpp"
+#include "Channel.hpp"
+#include "FileCache.hpp"
+#include "Affinity.hpp"
+#include "ThreadPool.hpp"
+#include "Logger.hpp"
+#include "Trace.hpp"
+#include "ListenPort.hpp"
+#include "Arena.hpp"
+#include "IdleWheel.hpp"
+#include "RateLimiter.hpp"
+#include "Compressor.hpp"
 #include <swoole/Server.h>
 
 using namespace std;
@@ -36,7 +49,8 @@ namespace swoole
         int server_socket;
     };
 
-    extern swString *_callback_buffer;
+    //every thread has its own, so DataBuffer can be used from the task threads
+    extern thread_local swString *_callback_buffer;
 
     struct DataBuffer
     {
@@ -72,6 +86,10 @@ namespace swoole
 
         void *alloc(size_t _size)
         {
+            if (_callback_buffer == NULL)
+            {
+                _callback_buffer = swString_new(8192);
+            }
             if (_size >= _callback_buffer->size)
             {
                 size_t new_size = _callback_buffer->size * 2;
@@ -104,6 +122,39 @@ namespace swoole
         EVENT_onTask = 1u << 9,
         EVENT_onFinish = 1u << 10,
         EVENT_onPipeMessage = 1u << 11,
+        EVENT_onBufferFull = 1u << 12,
+        EVENT_onBufferEmpty = 1u << 13,
+        EVENT_onReceiveChunk = 1u << 14,
+    };
+
+    /**
+     * One worker or task worker in a snapshot of Server::stats().
+     */
+    struct WorkerStats
+    {
+        int id;
+        pid_t pid;
+        bool task_worker;
+        bool busy;
+        //onReceive and onPacket
+        long request_count;
+        //onTask, in task workers or the task threads of a worker
+        long task_count;
+        long shed_count;
+    };
+
+    struct ServerStats
+    {
+        time_t start_time;
+        long connection_num;
+        long accept_count;
+        long close_count;
+        //dispatched to the task workers or task threads and not started yet
+        long tasking_num;
+        long request_count;
+        long shed_count;
+        long rate_limited;
+        vector<WorkerStats> workers;
     };
 
     class Server
@@ -112,19 +163,168 @@ namespace swoole
         Server(string _host, int _port, int _mode = SW_MODE_PROCESS, int _type = SW_SOCK_TCP);
 
         virtual ~Server()
-        {};
+        {
+            delete contexts;
+            delete task_pool;
+            delete admin_handler;
+            if (worker_counters)
+            {
+                sw_shm_free(worker_counters);
+            }
+            if (reload_state)
+            {
+                sw_shm_free(reload_state);
+            }
+            for (size_t i = 0; i < listen_ports.size(); i++)
+            {
+                delete listen_ports[i];
+            }
+            for (size_t i = 0; i < channels.size(); i++)
+            {
+                delete channels[i];
+            }
+        };
 
         bool start(void);
         void setEvents(int _events);
-        bool listen(string host, int port, int type);
+        /**
+         * SW_MODE_SINGLE only: every worker listens on its own SO_REUSEPORT socket,
+         * the kernel spreads the connections and each worker accepts and handles them in-process.
+         */
+        void setReusePort(bool enable);
+        void setAffinity(const Affinity &_affinity);
+        /**
+         * onBufferFull fires once the output buffer of a connection grows past high,
+         * onBufferEmpty once it drains back under low.
+         */
+        void setBufferWatermark(size_t high, size_t low);
+        size_t pendingBytes(int fd);
+        /**
+         * Run task() on num threads inside every worker instead of the task worker processes.
+         * onTask is then called concurrently from these threads, onFinish stays on the reactor.
+         */
+        void setTaskThreads(int num);
+        /**
+         * Give every worker a ring of the logger, the writer thread runs in the master.
+         */
+        void setLogger(Logger *_logger);
+        /**
+         * Sample a share of onReceive/onPacket as traces, their tasks, results and pipe messages
+         * carry the context. Every process appends its spans to a file in dir.
+         */
+        void setTrace(const string &dir, double sample_rate);
+        /**
+         * Close connections that have received nothing for seconds, checked once a second.
+         */
+        void setIdleTimeout(int seconds);
+        /**
+         * Check every TCP message against the limiter in the reactor, after it is read
+         * and before it is sent to a worker. Must be set before start().
+         */
+        void setRateLimiter(RateLimiter *_limiter);
+        /**
+         * Level and the smallest length worth compressing for sendCompressed().
+         */
+        void setCompression(int level, size_t min_length);
+
+        bool isCompressible(size_t length)
+        {
+            return length >= compress_min_length;
+        }
+
+        /**
+         * Deflate data straight into the output of the connection chunk by chunk,
+         * without a compressed copy of the whole data.
+         */
+        bool sendCompressed(int fd, const DataBuffer &data, CompressEncoding encoding = ENCODING_GZIP);
+        /**
+         * Limits of the tasks queued for all task workers, of the tasks this worker waits for,
+         * and of the output queued for one connection. 0 means no limit.
+         * Past a limit task() fails at once with SW_CPP_ERROR_SHED.
+         */
+        void setAdmission(size_t max_tasking, size_t max_worker_tasks, size_t max_output_bytes);
+        /**
+         * False if new work should be shed, the caller can answer with an error right away.
+         * With fd, the output buffer of the connection is checked as well.
+         */
+        bool admit(int fd = -1);
+
+        long getShedCount()
+        {
+            return shed_count;
+        }
+        bool isBufferFull(int fd);
+        /**
+         * Counters of the whole server, read from shared memory, so any worker gets the same picture.
+         */
+        ServerStats stats(void);
+        /**
+         * stats() in the Prometheus text format.
+         */
+        string statsText(void);
+        /**
+         * Serve statsText() on host:port, to plain HTTP GETs and to any other line as well.
+         * Returns NULL on failure, it must be called before start().
+         */
+        ListenPort *setAdminPort(const string &host, int admin_port);
+        /**
+         * Restart the workers and task workers, or only the task workers, one at a time, from any process.
+         * A worker first gets the results of its tasks back, then finishes the event it is handling and stops,
+         * the next one follows once its replacement has run onWorkerStart. A worker still there after
+         * the reload timeout is killed. Returns false while another reload is running.
+         * Events are dispatched to the worker until it stops, those still queued for it are lost.
+         * The rollout runs in a helper process that start() forks before libswoole creates any thread.
+         * In SW_MODE_PROCESS the connections stay with the reactor threads. In SW_MODE_SINGLE they close
+         * with their worker, and with one worker, which runs in the master, only reload(true) is allowed.
+         */
+        bool reload(bool only_task_workers = false);
+
+        void setReloadTimeout(int seconds)
+        {
+            reload_timeout = seconds;
+        }
+
+        /**
+         * The placement applied to reactor threads, workers and task workers.
+         */
+        const Affinity &getAffinity()
+        {
+            return affinity;
+        }
+
+        /**
+         * Returns NULL on failure. A port with a handler set reports to it instead of the Server.
+         */
+        ListenPort *listen(string host, int port, int type);
+        /**
+         * Ports in the order of listen(), 0 is the port of the constructor.
+         */
+        ListenPort *getPort(size_t index)
+        {
+            return index < listen_ports.size() ? listen_ports[index] : NULL;
+        }
+
         bool send(int fd, const char *data, int length);
         bool send(int fd, const DataBuffer &data);
+        int broadcast(const vector<int> &fds, const char *data, int length);
+        int broadcast(const vector<int> &fds, const DataBuffer &data);
         bool sendfile(int fd, string &file, off_t offset = 0);
+        bool sendfile(int fd, const string &file, off_t offset, size_t length, const DataBuffer &header = DataBuffer());
         bool sendMessage(int worker_id, DataBuffer &data);
+        /**
+         * Deliver sendMessage() to event workers through shared memory rings instead of pipes,
+         * messages larger than slot_size or hitting a full ring still go through the pipe.
+         */
+        void setMessageChannel(size_t capacity, size_t slot_size);
         bool sendwait(int fd, const DataBuffer &data);
         bool close(int fd, bool reset = false);
         bool sendto(const string &ip, int port, const DataBuffer &data, int server_socket = -1);
         int task(DataBuffer &data, int dst_worker_id = -1);
+        /**
+         * Task threads take the payload without a copy. They have no task worker to pick,
+         * dst_worker_id must be -1 with them.
+         */
+        int task(string &&data, int dst_worker_id = -1);
         bool finish(DataBuffer &data);
         DataBuffer taskwait(const DataBuffer &data, double timeout = SW_TASKWAIT_TIMEOUT, int dst_worker_id = -1);
         map<int, DataBuffer> taskWaitMulti(const vector<DataBuffer> &data, double timeout = SW_TASKWAIT_TIMEOUT);
@@ -134,10 +334,38 @@ namespace swoole
             return SwooleG.error;
         }
 
+        /**
+         * Allocate a T for every connection before onConnect, destroy it after onClose.
+         */
+        template<typename T>
+        void setContext()
+        {
+            delete contexts;
+            contexts = new ConnectionContext<T>();
+        }
+
+        /**
+         * Slot of a connection for per-connection arrays of the worker, the socket fd behind the session.
+         */
+        int getConnectionIndex(int fd);
+
+        template<typename T>
+        T *getContext(int fd)
+        {
+            if (contexts == NULL)
+            {
+                return NULL;
+            }
+            return ((ConnectionContext<T> *) contexts)->get(getConnectionIndex(fd), fd);
+        }
+
         virtual void onStart() = 0;
         virtual void onShutdown() = 0;
         virtual void onWorkerStart(int worker_id) = 0;
         virtual void onWorkerStop(int worker_id) = 0;
+        /**
+         * onReceive, onPacket and onTask run with an Arena::current() that is reset when they return.
+         */
         virtual void onReceive(int fd, const DataBuffer &data) = 0;
         virtual void onConnect(int fd) = 0;
         virtual void onClose(int fd) = 0;
@@ -146,6 +374,28 @@ namespace swoole
         virtual void onTask(int, int, const DataBuffer &) = 0;
         virtual void onFinish(int, const DataBuffer &) = 0;
 
+        virtual void onBufferFull(int fd)
+        {};
+
+        virtual void onBufferEmpty(int fd)
+        {};
+
+        /**
+         * The worker stops waiting for the result of a task: its onTask returned without finish(),
+         * or nothing came back within SW_CPP_TASK_RESULT_TIMEOUT. Only with EVENT_onFinish.
+         */
+        virtual void onTaskDropped(int task_id)
+        {};
+
+        /**
+         * With EVENT_onReceiveChunk, a message too big for one pipe packet is not buffered:
+         * its pieces arrive here as they are read, the last one with last = true.
+         * Smaller messages still go to onReceive, and so does everything on a port with
+         * its own PortHandler. SW_MODE_PROCESS only.
+         */
+        virtual void onReceiveChunk(int fd, const DataBuffer &chunk, bool last)
+        {};
+
     public:
         static int _onReceive(swServer *serv, swEventData *req);
         static void _onConnect(swServer *serv, swDataHead *info);
@@ -158,14 +408,97 @@ namespace swoole
         static void _onWorkerStop(swServer *serv, int worker_id);
         static int _onTask(swServer *serv, swEventData *task);
         static int _onFinish(swServer *serv, swEventData *task);
+        static void _onBufferFull(swServer *serv, swDataHead *info);
+        static void _onBufferEmpty(swServer *serv, swDataHead *info);
+        static int _onChannelRead(swReactor *reactor, swEvent *event);
+        static int _onPipeRead(swReactor *reactor, swEvent *event);
 
     protected:
+        //by the listening socket, which the reactor passes in from_fd
+        PortHandler *getHandler(int server_socket)
+        {
+            return (size_t) server_socket < handlers.size() ? handlers[server_socket] : NULL;
+        }
+        void receiveChunk(swEventData *task);
+
         swServer serv;
         vector<swListenPort *> ports;
+        vector<ListenPort *> listen_ports;
+        vector<PortHandler *> handlers;
         string host;
         int port;
         int mode;
         int events;
+        bool reuse_port;
+        size_t buffer_high_watermark;
+        size_t buffer_low_watermark;
+        ContextStore *contexts;
+        size_t channel_capacity;
+        size_t channel_slot_size;
+        vector<Channel *> channels;
+        int task_thread_num;
+        ThreadPool *task_pool;
+        Logger *logger;
+        int idle_timeout;
+        IdleWheel *idle_wheel;
+        RateLimiter *rate_limiter;
+        int compress_level;
+        size_t max_tasking;
+        size_t max_worker_tasks;
+        size_t max_output_bytes;
+        //tasks of this worker waiting for onFinish
+        size_t worker_tasks;
+        //tasks sent to the task workers by id, with the time they were sent
+        unordered_map<int, time_t> waiting_tasks;
+        long shed_count;
+        //one per worker and task worker in shared memory, each on its own cache line
+        struct WorkerCounter
+        {
+            sw_atomic_long_t request_count;
+            sw_atomic_long_t task_count;
+            sw_atomic_long_t shed_count;
+            //tasks waiting for onFinish, reload() lets them come back before the worker is stopped
+            sw_atomic_long_t pending_tasks;
+            //set when onWorkerStart has returned
+            sw_atomic_long_t ready_pid;
+            char padding[64 - sizeof(sw_atomic_long_t) * 5];
+        };
+        WorkerCounter *worker_counters;
+        PortHandler *admin_handler;
+
+        //in shared memory, the rollout itself runs in the helper process forked by start()
+        struct ReloadState
+        {
+            sw_atomic_t running;
+            sw_atomic_t only_task_workers;
+            pid_t helper_pid;
+        };
+        ReloadState *reload_state;
+        int reload_timeout;
+
+        WorkerCounter *getWorkerCounter()
+        {
+            return worker_counters && SwooleWG.id < serv.worker_num + SwooleG.task_worker_num ?
+                    &worker_counters[SwooleWG.id] : NULL;
+        }
+
+        void reloadHelper(pid_t parent_pid);
+        bool reloadWorker(int worker_id);
+        void expireWorkerTasks(void);
+
+        void countWorkerTask(int delta)
+        {
+            worker_tasks += delta;
+            WorkerCounter *counter = getWorkerCounter();
+            if (counter)
+            {
+                counter->pending_tasks = (long) worker_tasks;
+            }
+        }
+
+        size_t compress_min_length;
+        FileCache file_cache;
+        Affinity affinity;
     };
 }
 #endif //SWOOLE_CPP_SERVER_H
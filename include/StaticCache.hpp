@@ -0,0 +1,91 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_STATIC_CACHE_HPP
+#define SWOOLE_CPP_STATIC_CACHE_HPP
+
+#include "Server.hpp"
+
+#include <sys/stat.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Complete HTTP responses (header + body) of small static files, built once per process.
+     * A hit needs no file syscall. It is not copy-free: Server::send copies the response into
+     * the output buffer, and in SW_MODE_PROCESS once more through the pipe to the reactor thread.
+     */
+    class StaticCache
+    {
+    public:
+        struct Response
+        {
+            char *data;
+            size_t length;
+
+            Response()
+            {
+                data = NULL;
+                length = 0;
+            }
+        };
+
+        struct Entry
+        {
+            string path;
+            struct stat info;
+            time_t expire;
+            Response plain;
+            //built from a pre-compressed sibling file "<path>.gz"
+            Response gzip;
+            //zeroed when there is no sibling
+            struct stat gzip_info;
+        };
+
+        StaticCache(size_t _memory_limit = SW_CPP_STATIC_CACHE_MEMORY, size_t _max_file_size = SW_CPP_STATIC_CACHE_FILE_SIZE);
+        virtual ~StaticCache();
+
+        const Entry *get(const string &path);
+        /**
+         * Files that are too big for the cache fall back to Server::sendfile with the same header.
+         */
+        bool send(Server &server, int fd, const string &path, bool accept_gzip = false);
+        void clear(void);
+
+        size_t getMemoryUsage()
+        {
+            return memory_usage;
+        }
+
+    protected:
+        virtual string buildHeader(const string &path, const struct stat &info, size_t length, bool gzip);
+        bool load(Entry *entry);
+        bool loadResponse(Response *response, const string &header, const string &file, size_t length);
+        void release(Entry *entry);
+
+        size_t memory_limit;
+        size_t max_file_size;
+        size_t memory_usage;
+        list<Entry> lru;
+        unordered_map<string, list<Entry>::iterator> index;
+    };
+}
+#endif //SWOOLE_CPP_STATIC_CACHE_HPP
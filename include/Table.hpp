@@ -0,0 +1,109 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_TABLE_HPP
+#define SWOOLE_CPP_TABLE_HPP
+
+#include "Base.hpp"
+#include <swoole/table.h>
+
+#include <string>
+#include <functional>
+
+using namespace std;
+
+namespace swoole
+{
+    class TableRow
+    {
+    public:
+        TableRow(swTable *_table, swTableRow *_row)
+        {
+            table = _table;
+            row = _row;
+        }
+
+        bool get(const string &column, long &value);
+        bool get(const string &column, double &value);
+        bool get(const string &column, string &value);
+        bool set(const string &column, long value);
+        bool set(const string &column, double value);
+        bool set(const string &column, const string &value);
+
+    protected:
+        swTable *table;
+        swTableRow *row;
+    };
+
+    /**
+     * Fixed-schema hash table in shared memory, it must be created before Server::start()
+     * so that every worker and task worker inherits the same mapping.
+     * Every operation only locks the row it touches.
+     */
+    class Table
+    {
+    public:
+        enum ColumnType
+        {
+            TYPE_INT = SW_TABLE_INT,
+            TYPE_FLOAT = SW_TABLE_FLOAT,
+            TYPE_STRING = SW_TABLE_STRING,
+        };
+
+        Table(size_t rows);
+        ~Table();
+
+        bool column(const string &name, ColumnType type, size_t size = 0);
+        bool create(void);
+
+        bool set(const string &key, const string &column, long value);
+        bool set(const string &key, const string &column, double value);
+        bool set(const string &key, const string &column, const string &value);
+        bool get(const string &key, const string &column, long &value);
+        bool get(const string &key, const string &column, double &value);
+        bool get(const string &key, const string &column, string &value);
+        bool incr(const string &key, const string &column, long incrby = 1, long *value = NULL);
+        bool incr(const string &key, const string &column, double incrby, double *value = NULL);
+        bool exists(const string &key);
+        bool del(const string &key);
+        size_t count(void);
+
+        /**
+         * Read and write a row as one step: the callback runs with the row locked,
+         * a missing row is created first, as by incr(). It must not call the table.
+         * Returns false if the row cannot be created.
+         */
+        bool update(const char *key, size_t keylen, const function<void(TableRow &row)> &callback);
+
+        bool update(const string &key, const function<void(TableRow &row)> &callback)
+        {
+            return update(key.c_str(), key.length(), callback);
+        }
+
+        /**
+         * The callback runs with the row locked, it must not write the table.
+         * Return false from the callback to stop the iteration.
+         */
+        void each(const function<bool(const char *key, TableRow &row)> &callback);
+
+    protected:
+        bool setValue(const string &key, const string &column, ColumnType type, void *value, int length);
+
+        swTable *table;
+        bool created;
+    };
+}
+#endif //SWOOLE_CPP_TABLE_HPP
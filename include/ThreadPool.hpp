@@ -0,0 +1,85 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_THREAD_POOL_HPP
+#define SWOOLE_CPP_THREAD_POOL_HPP
+
+#include "Base.hpp"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Work-stealing thread pool living inside one worker process.
+     * Each thread pops its own queue from the back and steals from the front of the others.
+     * complete() hands a callback back to the reactor of the process, woken up through an eventfd.
+     */
+    class ThreadPool
+    {
+    public:
+        typedef function<void(void)> Job;
+
+        ThreadPool(int thread_num);
+        ~ThreadPool();
+
+        void dispatch(const Job &job);
+        /**
+         * Thread safe, the callback runs in the reactor thread.
+         */
+        void complete(const Job &callback);
+        bool attach(swReactor *reactor);
+        /**
+         * Run the finished callbacks, for processes without a reactor.
+         */
+        void wait(void);
+
+        static int onReactorRead(swReactor *reactor, swEvent *event);
+
+    protected:
+        struct Queue
+        {
+            mutex lock;
+            deque<Job> jobs;
+        };
+
+        void run(int id);
+        bool pop(int id, Job &job);
+        void runCompletions(void);
+
+        vector<Queue *> queues;
+        vector<thread> threads;
+        atomic<unsigned long> round;
+        atomic<long> pending;
+        atomic<long> active;
+        mutex sleep_lock;
+        condition_variable sleep_cond;
+        bool running;
+
+        int efd;
+        mutex completion_lock;
+        vector<Job> completions;
+    };
+}
+#endif //SWOOLE_CPP_THREAD_POOL_HPP
@@ -30,7 +30,7 @@ namespace swoole
     public:
         Timer(long ms, bool interval);
         Timer(long ms);
-        ~Timer()
+        virtual ~Timer()
         {
             clear();
         }
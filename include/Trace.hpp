@@ -0,0 +1,102 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#ifndef SWOOLE_CPP_TRACE_HPP
+#define SWOOLE_CPP_TRACE_HPP
+
+#include "Base.hpp"
+
+#include <string>
+
+using namespace std;
+
+namespace swoole
+{
+    /**
+     * Travels in front of the payload of tasks, results and pipe messages,
+     * marked by SW_CPP_TASK_TRACE in the task type.
+     */
+    struct TraceContext
+    {
+        uint64_t trace_id;
+        uint64_t span_id;
+    };
+
+    /**
+     * Spans of this process, buffered and appended as Chrome trace events (one JSON object per line)
+     * to <dir>/trace-<pid>.json. tools/trace_merge joins the files of all processes.
+     */
+    class Tracer
+    {
+    public:
+        static void enable(const string &dir, double sample_rate);
+
+        static bool isEnabled()
+        {
+            return enabled;
+        }
+
+        /**
+         * Whether a new trace should start, by the sample rate.
+         */
+        static bool sample(void);
+        /**
+         * Context of the running span of this thread, NULL outside of a trace.
+         */
+        static TraceContext *current(void);
+        static uint64_t newId(void);
+        static void record(const char *name, const TraceContext &ctx, uint64_t parent_id, int64_t start_usec,
+                           int64_t end_usec);
+        static void flush(void);
+
+    protected:
+        static bool enabled;
+        static double sample_rate;
+        static string dir;
+    };
+
+    /**
+     * A span from construction to destruction, it is the current span of the thread meanwhile.
+     * Without a parent and outside of a trace it does nothing.
+     */
+    class TraceSpan
+    {
+    public:
+        enum Root
+        {
+            ROOT,
+        };
+
+        //child of the current span
+        TraceSpan(const char *name);
+        //child of a span of another process
+        TraceSpan(const char *name, const TraceContext *parent);
+        //first span of a new trace, if it is sampled
+        TraceSpan(const char *name, Root root);
+        ~TraceSpan();
+
+    protected:
+        void begin(const char *_name, const TraceContext *parent);
+
+        const char *name;
+        bool active;
+        TraceContext ctx;
+        TraceContext saved;
+        uint64_t parent_id;
+        int64_t start_usec;
+    };
+}
+#endif //SWOOLE_CPP_TRACE_HPP
@@ -0,0 +1,258 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Affinity.hpp"
+
+#include <sched.h>
+#include <sys/syscall.h>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED    1
+#endif
+
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE      (1 << 1)
+#endif
+
+namespace swoole
+{
+    static const char *role_names[] = {"reactor", "worker", "task_worker"};
+
+    /**
+     * parse the kernel cpu list format, e.g. "0-7,16-23"
+     */
+    static vector<int> parse_cpu_list(const char *str)
+    {
+        vector<int> cpus;
+        while (*str)
+        {
+            char *end;
+            long first = strtol(str, &end, 10);
+            if (end == str)
+            {
+                break;
+            }
+            long last = first;
+            if (*end == '-')
+            {
+                str = end + 1;
+                last = strtol(str, &end, 10);
+            }
+            for (long i = first; i <= last; i++)
+            {
+                cpus.push_back((int) i);
+            }
+            str = end;
+            if (*str == ',')
+            {
+                str++;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return cpus;
+    }
+
+    int Affinity::getCpuNum(void)
+    {
+        return (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    int Affinity::getNodeNum(void)
+    {
+        char path[128];
+        int n = 0;
+        while (true)
+        {
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", n);
+            if (access(path, F_OK) < 0)
+            {
+                break;
+            }
+            n++;
+        }
+        return n > 0 ? n : 1;
+    }
+
+    vector<int> Affinity::getNodeCpus(int node)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        swString *content = swoole_file_get_contents(path);
+        if (content == NULL)
+        {
+            //no NUMA information, everything is on node 0
+            vector<int> cpus;
+            if (node == 0)
+            {
+                for (int i = 0; i < getCpuNum(); i++)
+                {
+                    cpus.push_back(i);
+                }
+            }
+            return cpus;
+        }
+        swString_append_ptr(content, "", 1);
+        vector<int> cpus = parse_cpu_list(content->str);
+        swString_free(content);
+        return cpus;
+    }
+
+    int Affinity::getCpuNode(int cpu)
+    {
+        char path[128];
+        int node_num = getNodeNum();
+        for (int i = 0; i < node_num; i++)
+        {
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpu%d", i, cpu);
+            if (access(path, F_OK) == 0)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    Affinity Affinity::preset(Preset preset, int reactor_num, int worker_num, int task_worker_num)
+    {
+        vector<int> cpus;
+        if (preset == PRESET_SPREAD)
+        {
+            for (int i = 0; i < getCpuNum(); i++)
+            {
+                cpus.push_back(i);
+            }
+        }
+        else
+        {
+            vector<vector<int> > nodes;
+            size_t max = 0;
+            for (int i = 0; i < getNodeNum(); i++)
+            {
+                vector<int> node_cpus = getNodeCpus(i);
+                if (preset == PRESET_IRQ && node_cpus.size() > 1)
+                {
+                    node_cpus.erase(node_cpus.begin());
+                }
+                if (node_cpus.size() > max)
+                {
+                    max = node_cpus.size();
+                }
+                nodes.push_back(node_cpus);
+            }
+            //interleave the nodes, so consecutive ids land on different nodes
+            for (size_t i = 0; i < max; i++)
+            {
+                for (size_t j = 0; j < nodes.size(); j++)
+                {
+                    if (i < nodes[j].size())
+                    {
+                        cpus.push_back(nodes[j][i]);
+                    }
+                }
+            }
+        }
+
+        Affinity affinity;
+        if (cpus.empty())
+        {
+            return affinity;
+        }
+        int num[ROLE_NUM] = {reactor_num, worker_num, task_worker_num};
+        size_t offset = 0;
+        for (int role = 0; role < ROLE_NUM; role++)
+        {
+            for (int i = 0; i < num[role]; i++)
+            {
+                affinity.roles[role].push_back(cpus[offset++ % cpus.size()]);
+            }
+        }
+        return affinity;
+    }
+
+    int Affinity::getCpu(Role role, int id) const
+    {
+        if (roles[role].empty() || id < 0)
+        {
+            return -1;
+        }
+        return roles[role][id % roles[role].size()];
+    }
+
+    int Affinity::getNode(Role role, int id) const
+    {
+        int cpu = getCpu(role, id);
+        return cpu < 0 ? -1 : getCpuNode(cpu);
+    }
+
+    string Affinity::toString() const
+    {
+        string str;
+        char buf[32];
+        for (int role = 0; role < ROLE_NUM; role++)
+        {
+            str += role_names[role];
+            str += ":";
+            for (size_t i = 0; i < roles[role].size(); i++)
+            {
+                snprintf(buf, sizeof(buf), " %d", roles[role][i]);
+                str += buf;
+            }
+            str += "\n";
+        }
+        return str;
+    }
+
+    bool Affinity::bindCpu(int cpu)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0)
+        {
+            swSysError("sched_setaffinity(%d) failed.", cpu);
+            return false;
+        }
+        return true;
+    }
+
+    bool Affinity::bindProcessMemory(int node)
+    {
+        unsigned long nodemask = 1UL << node;
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8) < 0)
+        {
+            swSysError("set_mempolicy(node=%d) failed.", node);
+            return false;
+        }
+        return true;
+    }
+
+    bool Affinity::bindMemory(void *addr, size_t length, int node)
+    {
+        unsigned long nodemask = 1UL << node;
+        //mbind() works on whole pages
+        unsigned long start = (unsigned long) addr & ~((unsigned long) SwooleG.pagesize - 1);
+        length += (unsigned long) addr - start;
+        if (syscall(SYS_mbind, start, length, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8, MPOL_MF_MOVE) < 0)
+        {
+            swSysError("mbind(node=%d) failed.", node);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,138 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Arena.hpp"
+
+#include <new>
+
+namespace swoole
+{
+    //one arena per thread, created by the first callback that asks for it
+    static thread_local Arena *thread_arena = NULL;
+    static thread_local int scope_depth = 0;
+
+    Arena::Arena(size_t _block_size, size_t _keep_size)
+    {
+        block_size = _block_size;
+        keep_size = _keep_size;
+        memory_size = 0;
+        head = block = newBlock(block_size);
+        cursor = head->data;
+        end = head->data + head->size;
+    }
+
+    Arena::~Arena()
+    {
+        while (head)
+        {
+            Block *next = head->next;
+            ::free(head);
+            head = next;
+        }
+    }
+
+    Arena::Block *Arena::newBlock(size_t size)
+    {
+        Block *_block = (Block *) ::malloc(sizeof(Block) + size);
+        if (_block == NULL)
+        {
+            swWarn("malloc(%ld) failed.", sizeof(Block) + size);
+            throw bad_alloc();
+        }
+        _block->next = NULL;
+        _block->size = size;
+        memory_size += size;
+        return _block;
+    }
+
+    void *Arena::allocSlow(size_t size, size_t align)
+    {
+        //blocks kept from earlier events are used again before new ones are made
+        while (block->next)
+        {
+            block = block->next;
+            cursor = block->data;
+            end = block->data + block->size;
+            char *ptr = (char *) (((uintptr_t) cursor + align - 1) & ~(uintptr_t) (align - 1));
+            if (ptr + size <= end)
+            {
+                cursor = ptr + size;
+                return ptr;
+            }
+        }
+
+        Block *_block = newBlock(size + align > block_size ? size + align : block_size);
+        block->next = _block;
+        block = _block;
+        cursor = block->data;
+        end = block->data + block->size;
+        return alloc(size, align);
+    }
+
+    void Arena::reset(void)
+    {
+        if (memory_size > keep_size)
+        {
+            size_t kept = head->size;
+            Block *prev = head;
+            for (Block *iter = head->next; iter; )
+            {
+                Block *next = iter->next;
+                if (kept + iter->size > keep_size)
+                {
+                    memory_size -= iter->size;
+                    ::free(iter);
+                    prev->next = next;
+                }
+                else
+                {
+                    kept += iter->size;
+                    prev = iter;
+                }
+                iter = next;
+            }
+        }
+        block = head;
+        cursor = head->data;
+        end = head->data + head->size;
+    }
+
+    Arena *Arena::current(void)
+    {
+        if (scope_depth == 0)
+        {
+            return NULL;
+        }
+        if (thread_arena == NULL)
+        {
+            thread_arena = new Arena();
+        }
+        return thread_arena;
+    }
+
+    ArenaScope::ArenaScope()
+    {
+        scope_depth++;
+    }
+
+    ArenaScope::~ArenaScope()
+    {
+        if (--scope_depth == 0 && thread_arena)
+        {
+            thread_arena->reset();
+        }
+    }
+}
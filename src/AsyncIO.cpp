@@ -0,0 +1,347 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "AsyncIO.hpp"
+#include "ThreadPool.hpp"
+
+#include <sys/stat.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace swoole
+{
+    struct AioRequest
+    {
+        int fd;
+        //opened by readFile/writeFile, closed before the callback
+        bool close_fd;
+        bool write;
+        string buffer;
+        size_t length;
+        size_t done;
+        off_t offset;
+        AsyncIO::ReadCallback onRead;
+        AsyncIO::WriteCallback onWrite;
+    };
+
+    static void aio_finish(AioRequest *req, int error)
+    {
+        if (req->close_fd)
+        {
+            ::close(req->fd);
+        }
+        if (req->write)
+        {
+            req->onWrite(error, req->done);
+        }
+        else
+        {
+            req->onRead(error, req->buffer.c_str(), req->done);
+        }
+        delete req;
+    }
+
+    static void pool_submit(AioRequest *req);
+
+#ifdef HAVE_LIBURING
+    static struct io_uring *ring = NULL;
+    static bool ring_failed = false;
+    static int ring_efd = -1;
+    static long ring_pending = 0;
+
+    static bool ring_init(void)
+    {
+        ring = new struct io_uring;
+        int ret = io_uring_queue_init(SW_CPP_AIO_QUEUE_DEPTH, ring, 0);
+        if (ret < 0)
+        {
+            //old kernel or seccomp, the thread pool takes over
+            swWarn("io_uring_queue_init() failed, %s. Using threads for file I/O.", strerror(-ret));
+            delete ring;
+            ring = NULL;
+            ring_failed = true;
+            return false;
+        }
+        if (SwooleG.main_reactor)
+        {
+            ring_efd = eventfd(0, EFD_NONBLOCK);
+            if (ring_efd < 0 || io_uring_register_eventfd(ring, ring_efd) < 0)
+            {
+                swSysError("io_uring_register_eventfd() failed.");
+            }
+            else
+            {
+                swReactor *reactor = SwooleG.main_reactor;
+                reactor->setHandle(reactor, FD_ASYNC_IO | SW_EVENT_READ, AsyncIO::onReactorRead);
+                reactor->add(reactor, ring_efd, FD_ASYNC_IO | SW_EVENT_READ);
+            }
+        }
+        return true;
+    }
+
+    static bool ring_submit(AioRequest *req)
+    {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        if (sqe == NULL)
+        {
+            io_uring_submit(ring);
+            sqe = io_uring_get_sqe(ring);
+            if (sqe == NULL)
+            {
+                return false;
+            }
+        }
+        char *buf = (char *) req->buffer.data() + req->done;
+        unsigned length = (unsigned) (req->length - req->done);
+        if (req->write)
+        {
+            io_uring_prep_write(sqe, req->fd, buf, length, req->offset + req->done);
+        }
+        else
+        {
+            io_uring_prep_read(sqe, req->fd, buf, length, req->offset + req->done);
+        }
+        io_uring_sqe_set_data(sqe, req);
+        io_uring_submit(ring);
+        return true;
+    }
+
+    static void ring_reap(void)
+    {
+        struct io_uring_cqe *cqe;
+        while (io_uring_peek_cqe(ring, &cqe) == 0)
+        {
+            AioRequest *req = (AioRequest *) io_uring_cqe_get_data(cqe);
+            int res = cqe->res;
+            io_uring_cqe_seen(ring, cqe);
+
+            bool more = false;
+            if (res > 0)
+            {
+                req->done += res;
+                //short read or write, go on with the rest
+                more = req->done < req->length;
+                if (more && ring_submit(req))
+                {
+                    continue;
+                }
+            }
+            ring_pending--;
+            //no room in the ring, a thread finishes the request
+            if (more)
+            {
+                pool_submit(req);
+                continue;
+            }
+            if (!req->write)
+            {
+                req->buffer.resize(req->done);
+            }
+            aio_finish(req, res < 0 ? -res : 0);
+        }
+    }
+#endif
+
+    static ThreadPool *pool = NULL;
+
+    static ThreadPool *get_pool(void)
+    {
+        if (pool == NULL)
+        {
+            pool = new ThreadPool(SW_CPP_AIO_THREAD_NUM);
+            if (SwooleG.main_reactor)
+            {
+                pool->attach(SwooleG.main_reactor);
+            }
+        }
+        return pool;
+    }
+
+    static void pool_io(AioRequest *req)
+    {
+        int error = 0;
+        while (req->done < req->length)
+        {
+            char *buf = (char *) req->buffer.data() + req->done;
+            size_t length = req->length - req->done;
+            ssize_t n;
+            if (req->write)
+            {
+                n = ::pwrite(req->fd, buf, length, req->offset + req->done);
+            }
+            else
+            {
+                n = ::pread(req->fd, buf, length, req->offset + req->done);
+            }
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                error = errno;
+                break;
+            }
+            //EOF
+            if (n == 0)
+            {
+                break;
+            }
+            req->done += n;
+        }
+        if (!req->write)
+        {
+            req->buffer.resize(req->done);
+        }
+        pool->complete([req, error]()
+        {
+            aio_finish(req, error);
+        });
+    }
+
+    static void pool_submit(AioRequest *req)
+    {
+        get_pool()->dispatch([req]()
+        {
+            pool_io(req);
+        });
+    }
+
+    static bool aio_submit(AioRequest *req)
+    {
+#ifdef HAVE_LIBURING
+        if ((ring || (!ring_failed && ring_init())) && ring_submit(req))
+        {
+            ring_pending++;
+            return true;
+        }
+#endif
+        pool_submit(req);
+        return true;
+    }
+
+    static AioRequest *new_request(int fd, bool close_fd, size_t length, off_t offset)
+    {
+        AioRequest *req = new AioRequest;
+        req->fd = fd;
+        req->close_fd = close_fd;
+        req->length = length;
+        req->done = 0;
+        req->offset = offset;
+        return req;
+    }
+
+    static bool aio_read(int fd, bool close_fd, size_t length, off_t offset, const AsyncIO::ReadCallback &callback)
+    {
+        AioRequest *req = new_request(fd, close_fd, length, offset);
+        req->write = false;
+        req->buffer.resize(length);
+        req->onRead = callback;
+        return aio_submit(req);
+    }
+
+    static bool aio_write(int fd, bool close_fd, const void *data, size_t length, off_t offset,
+                          const AsyncIO::WriteCallback &callback)
+    {
+        AioRequest *req = new_request(fd, close_fd, length, offset);
+        req->write = true;
+        req->buffer.assign((const char *) data, length);
+        req->onWrite = callback;
+        return aio_submit(req);
+    }
+
+    bool AsyncIO::pread(int fd, size_t length, off_t offset, const ReadCallback &callback)
+    {
+        return aio_read(fd, false, length, offset, callback);
+    }
+
+    bool AsyncIO::pwrite(int fd, const void *data, size_t length, off_t offset, const WriteCallback &callback)
+    {
+        return aio_write(fd, false, data, length, offset, callback);
+    }
+
+    bool AsyncIO::readFile(const string &file, const ReadCallback &callback)
+    {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            swSysError("open(%s) failed.", file.c_str());
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0)
+        {
+            swSysError("fstat(%s) failed.", file.c_str());
+            ::close(fd);
+            return false;
+        }
+        if (!aio_read(fd, true, (size_t) st.st_size, 0, callback))
+        {
+            ::close(fd);
+            return false;
+        }
+        return true;
+    }
+
+    bool AsyncIO::writeFile(const string &file, const void *data, size_t length, const WriteCallback &callback,
+                            int flags)
+    {
+        int fd = open(file.c_str(), flags, 0644);
+        if (fd < 0)
+        {
+            swSysError("open(%s) failed.", file.c_str());
+            return false;
+        }
+        if (!aio_write(fd, true, data, length, 0, callback))
+        {
+            ::close(fd);
+            return false;
+        }
+        return true;
+    }
+
+    int AsyncIO::onReactorRead(swReactor *reactor, swEvent *event)
+    {
+#ifdef HAVE_LIBURING
+        uint64_t flag;
+        while (read(event->fd, &flag, sizeof(flag)) > 0);
+        ring_reap();
+#endif
+        return SW_OK;
+    }
+
+    void AsyncIO::wait(void)
+    {
+#ifdef HAVE_LIBURING
+        while (ring_pending > 0)
+        {
+            struct io_uring_cqe *cqe;
+            if (io_uring_wait_cqe(ring, &cqe) < 0)
+            {
+                break;
+            }
+            ring_reap();
+        }
+#endif
+        if (pool)
+        {
+            pool->wait();
+        }
+    }
+}
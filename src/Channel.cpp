@@ -0,0 +1,167 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Channel.hpp"
+#include "Affinity.hpp"
+#include <sys/eventfd.h>
+
+namespace swoole
+{
+    Channel::Channel(size_t capacity, size_t _slot_size)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        mask = size - 1;
+        slot_size = _slot_size;
+        //reserve one byte for the terminating null of DataBuffer
+        cell_size = SW_MEM_ALIGNED_SIZE(sizeof(Cell) + slot_size + 1);
+        memory_size = sizeof(Header) + cell_size * size;
+
+        char *memory = (char *) sw_shm_malloc(memory_size);
+        if (memory == NULL)
+        {
+            swWarn("sw_shm_malloc(%ld) failed.", memory_size);
+            abort();
+        }
+        header = (Header *) memory;
+        cells = memory + sizeof(Header);
+        header->enqueue_pos = 0;
+        header->dequeue_pos = 0;
+        header->waiting = 1;
+        for (size_t i = 0; i < size; i++)
+        {
+            getCell(i)->sequence = i;
+        }
+
+        efd = eventfd(0, EFD_NONBLOCK);
+        if (efd < 0)
+        {
+            swSysError("eventfd() failed.");
+            abort();
+        }
+    }
+
+    Channel::~Channel()
+    {
+        ::close(efd);
+        sw_shm_free(header);
+    }
+
+    bool Channel::push(int src_worker_id, const void *data, size_t length)
+    {
+        if (length > slot_size)
+        {
+            return false;
+        }
+
+        Cell *cell;
+        uint64_t pos = __atomic_load_n(&header->enqueue_pos, __ATOMIC_RELAXED);
+        while (true)
+        {
+            cell = getCell(pos);
+            uint64_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+            int64_t dif = (int64_t) seq - (int64_t) pos;
+            if (dif == 0)
+            {
+                if (__atomic_compare_exchange_n(&header->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED))
+                {
+                    break;
+                }
+            }
+            //full
+            else if (dif < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = __atomic_load_n(&header->enqueue_pos, __ATOMIC_RELAXED);
+            }
+        }
+
+        cell->src_worker_id = src_worker_id;
+        cell->length = (uint32_t) length;
+        memcpy(cell->data, data, length);
+        __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+        //empty -> non-empty, wake up the consumer
+        sw_atomic_memory_barrier();
+        if (header->waiting && sw_atomic_cmp_set(&header->waiting, 1, 0))
+        {
+            notify();
+        }
+        return true;
+    }
+
+    bool Channel::peek(int *src_worker_id, char **data, size_t *length)
+    {
+        uint64_t pos = header->dequeue_pos;
+        Cell *cell = getCell(pos);
+        if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != pos + 1)
+        {
+            return false;
+        }
+        *src_worker_id = cell->src_worker_id;
+        *data = cell->data;
+        *length = cell->length;
+        cell->data[cell->length] = '\0';
+        return true;
+    }
+
+    void Channel::pop(void)
+    {
+        uint64_t pos = header->dequeue_pos;
+        header->dequeue_pos = pos + 1;
+        __atomic_store_n(&getCell(pos)->sequence, pos + mask + 1, __ATOMIC_RELEASE);
+    }
+
+    bool Channel::sleep(void)
+    {
+        header->waiting = 1;
+        sw_atomic_memory_barrier();
+        uint64_t pos = header->dequeue_pos;
+        if (__atomic_load_n(&getCell(pos)->sequence, __ATOMIC_ACQUIRE) == pos + 1)
+        {
+            header->waiting = 0;
+            return false;
+        }
+        return true;
+    }
+
+    void Channel::notify(void)
+    {
+        uint64_t flag = 1;
+        if (write(efd, &flag, sizeof(flag)) < 0 && errno != EAGAIN)
+        {
+            swSysError("write(eventfd) failed.");
+        }
+    }
+
+    void Channel::clearNotify(void)
+    {
+        uint64_t flag;
+        while (read(efd, &flag, sizeof(flag)) > 0);
+    }
+
+    bool Channel::bindNode(int node)
+    {
+        return Affinity::bindMemory(header, memory_size, node);
+    }
+}
@@ -0,0 +1,159 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Compressor.hpp"
+
+#include <vector>
+
+namespace swoole
+{
+    //levels -1..9 times two encodings
+    static const int LEVEL_NUM = 11;
+
+    static thread_local vector<z_stream *> pool[LEVEL_NUM * 2];
+
+    //the output buffer of the streams of this thread
+    static thread_local char *chunk_buffer = NULL;
+
+    z_stream *CompressorPool::acquire(int level, CompressEncoding encoding, int *index)
+    {
+        if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+        {
+            level = Z_DEFAULT_COMPRESSION;
+        }
+        *index = (level + 1) * 2 + (encoding == ENCODING_GZIP ? 0 : 1);
+        vector<z_stream *> &list = pool[*index];
+        if (!list.empty())
+        {
+            z_stream *stream = list.back();
+            list.pop_back();
+            return stream;
+        }
+
+        z_stream *stream = new z_stream;
+        memset(stream, 0, sizeof(*stream));
+        //+16 writes the gzip header and trailer
+        int window_bits = encoding == ENCODING_GZIP ? MAX_WBITS + 16 : MAX_WBITS;
+        if (deflateInit2(stream, level, Z_DEFLATED, window_bits, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            swWarn("deflateInit2() failed.");
+            delete stream;
+            return NULL;
+        }
+        return stream;
+    }
+
+    void CompressorPool::release(z_stream *stream, int index)
+    {
+        vector<z_stream *> &list = pool[index];
+        if (list.size() >= SW_CPP_COMPRESSOR_POOL_SIZE || deflateReset(stream) != Z_OK)
+        {
+            deflateEnd(stream);
+            delete stream;
+            return;
+        }
+        list.push_back(stream);
+    }
+
+    CompressStream::CompressStream(const Output &_output, int level, CompressEncoding encoding) :
+            output(_output)
+    {
+        input_bytes = 0;
+        output_bytes = 0;
+        stream = CompressorPool::acquire(level, encoding, &pool_index);
+        if (chunk_buffer == NULL)
+        {
+            chunk_buffer = new char[SW_CPP_COMPRESS_CHUNK_SIZE];
+        }
+    }
+
+    CompressStream::~CompressStream()
+    {
+        release();
+    }
+
+    void CompressStream::release(void)
+    {
+        if (stream)
+        {
+            CompressorPool::release(stream, pool_index);
+            stream = NULL;
+        }
+    }
+
+    bool CompressStream::deflateTo(int flush)
+    {
+        do
+        {
+            stream->next_out = (Bytef *) chunk_buffer;
+            stream->avail_out = SW_CPP_COMPRESS_CHUNK_SIZE;
+            int ret = deflate(stream, flush);
+            if (ret == Z_STREAM_ERROR)
+            {
+                swWarn("deflate() failed.");
+                return false;
+            }
+            size_t n = SW_CPP_COMPRESS_CHUNK_SIZE - stream->avail_out;
+            if (n > 0)
+            {
+                output_bytes += n;
+                if (!output(chunk_buffer, n))
+                {
+                    return false;
+                }
+            }
+        } while (stream->avail_out == 0);
+        return true;
+    }
+
+    bool CompressStream::write(const void *data, size_t length)
+    {
+        if (stream == NULL)
+        {
+            return false;
+        }
+        input_bytes += length;
+        const char *ptr = (const char *) data;
+        //avail_in is 32 bits
+        while (length > 0)
+        {
+            uInt n = length > (1u << 30) ? (1u << 30) : (uInt) length;
+            stream->next_in = (Bytef *) ptr;
+            stream->avail_in = n;
+            if (!deflateTo(Z_NO_FLUSH))
+            {
+                release();
+                return false;
+            }
+            ptr += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    bool CompressStream::end(void)
+    {
+        if (stream == NULL)
+        {
+            return false;
+        }
+        stream->next_in = NULL;
+        stream->avail_in = 0;
+        bool retval = deflateTo(Z_FINISH);
+        release();
+        return retval;
+    }
+}
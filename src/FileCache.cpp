@@ -0,0 +1,113 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "FileCache.hpp"
+
+namespace swoole
+{
+    bool FileCache::open(File *file)
+    {
+        file->fd = ::open(file->path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file->fd < 0)
+        {
+            swSysError("open(%s) failed.", file->path.c_str());
+            return false;
+        }
+        if (fstat(file->fd, &file->info) < 0)
+        {
+            swSysError("fstat(%s) failed.", file->path.c_str());
+            ::close(file->fd);
+            file->fd = -1;
+            return false;
+        }
+        file->expire = time(NULL) + ttl;
+        return true;
+    }
+
+    FileCache::File *FileCache::get(const string &path)
+    {
+        auto iter = index.find(path);
+        if (iter != index.end())
+        {
+            File *file = &(*iter->second);
+            //move to the front of the LRU list
+            lru.splice(lru.begin(), lru, iter->second);
+
+            time_t now = time(NULL);
+            if (file->expire > now)
+            {
+                return file;
+            }
+
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0 && info.st_ino == file->info.st_ino && info.st_dev == file->info.st_dev
+                && info.st_mtime == file->info.st_mtime && info.st_size == file->info.st_size)
+            {
+                file->expire = now + ttl;
+                return file;
+            }
+            //replaced or modified
+            ::close(file->fd);
+            if (open(file))
+            {
+                return file;
+            }
+            index.erase(path);
+            lru.pop_front();
+            return NULL;
+        }
+
+        File file;
+        file.path = path;
+        if (!open(&file))
+        {
+            return NULL;
+        }
+        lru.push_front(file);
+        index[path] = lru.begin();
+
+        if (lru.size() > max_files)
+        {
+            File &last = lru.back();
+            ::close(last.fd);
+            index.erase(last.path);
+            lru.pop_back();
+        }
+        return &lru.front();
+    }
+
+    void FileCache::remove(const string &path)
+    {
+        auto iter = index.find(path);
+        if (iter == index.end())
+        {
+            return;
+        }
+        ::close(iter->second->fd);
+        lru.erase(iter->second);
+        index.erase(iter);
+    }
+
+    void FileCache::clear(void)
+    {
+        for (auto iter = lru.begin(); iter != lru.end(); iter++)
+        {
+            ::close(iter->fd);
+        }
+        lru.clear();
+        index.clear();
+    }
+}
@@ -0,0 +1,79 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "IdleWheel.hpp"
+
+namespace swoole
+{
+    IdleWheel::IdleWheel(int _timeout, const CloseHandler &_onIdle) :
+            Timer(1000, true), onIdle(_onIdle)
+    {
+        timeout = _timeout;
+        //seconds since the wheel started, counted by the ticks
+        now = 0;
+        slots.resize(timeout + 1);
+    }
+
+    void IdleWheel::add(int index, int session_id)
+    {
+        if ((size_t) index >= sessions.size())
+        {
+            sessions.resize(index + 1, 0);
+            last_active.resize(index + 1, 0);
+        }
+        sessions[index] = session_id;
+        last_active[index] = now;
+        Entry entry = {index, session_id};
+        slots[(now + timeout) % slots.size()].push_back(entry);
+    }
+
+    void IdleWheel::callback(void)
+    {
+        now++;
+        vector<Entry> &slot = slots[now % slots.size()];
+        if (slot.empty())
+        {
+            return;
+        }
+
+        vector<Entry> due;
+        due.swap(slot);
+        for (auto iter = due.begin(); iter != due.end(); iter++)
+        {
+            //closed meanwhile, or the index belongs to a new connection
+            if (sessions[iter->index] != iter->session_id)
+            {
+                continue;
+            }
+            uint32_t deadline = last_active[iter->index] + timeout;
+            if (deadline > now)
+            {
+                slots[deadline % slots.size()].push_back(*iter);
+            }
+            else
+            {
+                sessions[iter->index] = 0;
+                expired.push_back(iter->session_id);
+            }
+        }
+
+        for (auto iter = expired.begin(); iter != expired.end(); iter++)
+        {
+            onIdle(*iter);
+        }
+        expired.clear();
+    }
+}
@@ -0,0 +1,81 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "ListenPort.hpp"
+
+namespace swoole
+{
+    static int length_type_size(char type)
+    {
+        switch (type)
+        {
+        case 'c':
+        case 'C':
+            return 1;
+        case 's':
+        case 'S':
+        case 'n':
+        case 'v':
+            return 2;
+        case 'l':
+        case 'L':
+        case 'N':
+        case 'V':
+            return 4;
+        default:
+            return -1;
+        }
+    }
+
+    bool ListenPort::setLengthCheck(char length_type, uint16_t length_offset, uint16_t body_offset,
+                                    uint32_t max_length)
+    {
+        int size = length_type_size(length_type);
+        if (size < 0)
+        {
+            swWarn("unknown package length type '%c'.", length_type);
+            return false;
+        }
+        ls->open_length_check = 1;
+        ls->open_eof_check = 0;
+        ls->protocol.package_length_type = length_type;
+        ls->protocol.package_length_size = (uint8_t) size;
+        ls->protocol.package_length_offset = length_offset;
+        ls->protocol.package_body_offset = body_offset;
+        ls->protocol.package_max_length = max_length;
+        return true;
+    }
+
+    bool ListenPort::setEofCheck(const string &eof, uint32_t max_length)
+    {
+        if (eof.empty() || eof.length() > sizeof(ls->protocol.package_eof))
+        {
+            swWarn("the length of package eof must be 1-%d.", (int) sizeof(ls->protocol.package_eof));
+            return false;
+        }
+        ls->open_eof_check = 1;
+        ls->open_length_check = 0;
+        memcpy(ls->protocol.package_eof, eof.c_str(), eof.length());
+        ls->protocol.package_eof_len = (uint8_t) eof.length();
+        ls->protocol.package_max_length = max_length;
+        return true;
+    }
+
+    void ListenPort::setTcpNodelay(bool enable)
+    {
+        ls->open_tcp_nodelay = enable ? 1 : 0;
+    }
+}
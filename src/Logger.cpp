@@ -0,0 +1,351 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Logger.hpp"
+
+#include <stdarg.h>
+#include <sys/time.h>
+
+namespace swoole
+{
+    static const char *level_names[] = {"DEBUG", "TRACE", "INFO", "NOTICE", "WARNING", "ERROR"};
+
+    static inline size_t record_size(size_t text_length)
+    {
+        return (sizeof(uint64_t) * 2 + text_length + 7) & ~((size_t) 7);
+    }
+
+    static inline int64_t now_usec(void)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    Logger::Logger(string _file, size_t _ring_size) :
+            file(_file), level(SW_LOG_INFO), policy(LOG_OVERFLOW_DROP), rate_limit(SW_CPP_LOG_RATE_LIMIT)
+    {
+        size_t size = 4096;
+        while (size < _ring_size)
+        {
+            size *= 2;
+        }
+        ring_size = size;
+        ring_num = 0;
+        memory = NULL;
+        running = false;
+        writer_time.second = 0;
+        sync_time.second = 0;
+
+        fd = open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            swSysError("open(%s) failed.", file.c_str());
+        }
+    }
+
+    Logger::~Logger()
+    {
+        stop();
+        if (memory)
+        {
+            sw_shm_free(memory);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+
+    bool Logger::create(int _ring_num)
+    {
+        size_t memory_size = (sizeof(Ring) + ring_size) * _ring_num;
+        memory = (char *) sw_shm_malloc(memory_size);
+        if (memory == NULL)
+        {
+            swWarn("sw_shm_malloc(%ld) failed.", memory_size);
+            return false;
+        }
+        ring_num = _ring_num;
+        for (int i = 0; i < ring_num; i++)
+        {
+            Ring *ring = getRing(i);
+            ring->write_pos = 0;
+            ring->read_pos = 0;
+            ring->lock = 0;
+            ring->dropped = 0;
+        }
+        return true;
+    }
+
+    bool Logger::start(void)
+    {
+        if (running || fd < 0)
+        {
+            return false;
+        }
+        running = true;
+        writer = thread(&Logger::run, this);
+        return true;
+    }
+
+    void Logger::stop(void)
+    {
+        if (!running)
+        {
+            return;
+        }
+        running = false;
+        writer.join();
+    }
+
+    void Logger::log(int _level, const char *format, ...)
+    {
+        if (_level < level)
+        {
+            return;
+        }
+        va_list args;
+        va_start(args, format);
+        vlog(_level, format, args);
+        va_end(args);
+    }
+
+    void Logger::log(LogSite *site, int _level, const char *format, ...)
+    {
+        if (_level < level)
+        {
+            return;
+        }
+        time_t now = time(NULL);
+        if (site->second != now)
+        {
+            if (site->suppressed > 0)
+            {
+                log(SW_LOG_WARNING, "%u records suppressed at %s:%d", site->suppressed, site->file, site->line);
+            }
+            site->second = now;
+            site->count = 0;
+            site->suppressed = 0;
+        }
+        if (rate_limit > 0 && ++site->count > rate_limit)
+        {
+            site->suppressed++;
+            return;
+        }
+        va_list args;
+        va_start(args, format);
+        vlog(_level, format, args);
+        va_end(args);
+    }
+
+    void Logger::vlog(int _level, const char *format, va_list args)
+    {
+        char text[SW_CPP_LOG_LINE_SIZE];
+        int n = vsnprintf(text, sizeof(text), format, args);
+        if (n < 0)
+        {
+            return;
+        }
+        size_t length = (size_t) n < sizeof(text) ? (size_t) n : sizeof(text) - 1;
+
+        int worker_id = SwooleWG.id;
+        if ((swIsWorker() || swIsTaskWorker()) && worker_id < ring_num)
+        {
+            push(getRing(worker_id), _level, text, length);
+        }
+        else
+        {
+            writeSync(_level, text, length);
+        }
+    }
+
+    bool Logger::push(Ring *ring, int _level, const char *text, size_t length)
+    {
+        size_t size = record_size(length);
+        int64_t usec = now_usec();
+        //a writer that is gone must not hang the worker
+        int retry = 1000;
+
+        while (true)
+        {
+            sw_spinlock(&ring->lock);
+            uint64_t write_pos = ring->write_pos;
+            uint64_t read_pos = __atomic_load_n(&ring->read_pos, __ATOMIC_ACQUIRE);
+            size_t offset = write_pos & (ring_size - 1);
+            size_t tail = ring_size - offset;
+            //a record never wraps, the rest of the ring is skipped with a pad
+            size_t need = tail < size ? tail + size : size;
+
+            if (write_pos + need - read_pos <= ring_size)
+            {
+                if (tail < size)
+                {
+                    Record *pad = (Record *) (ring->data + offset);
+                    pad->length = (uint32_t) tail;
+                    pad->type = RECORD_PAD;
+                    offset = 0;
+                }
+                Record *record = (Record *) (ring->data + offset);
+                record->length = (uint32_t) size;
+                record->level = (uint8_t) _level;
+                record->type = RECORD_TEXT;
+                record->text_length = (uint16_t) length;
+                record->usec = usec;
+                memcpy(record->text, text, length);
+                __atomic_store_n(&ring->write_pos, write_pos + need, __ATOMIC_RELEASE);
+                sw_spinlock_release(&ring->lock);
+                return true;
+            }
+            sw_spinlock_release(&ring->lock);
+
+            if (policy == LOG_OVERFLOW_BLOCK && retry-- > 0)
+            {
+                usleep(1000);
+                continue;
+            }
+            else if (policy == LOG_OVERFLOW_SYNC)
+            {
+                writeSync(_level, text, length);
+                return true;
+            }
+            sw_atomic_fetch_add(&ring->dropped, 1);
+            return false;
+        }
+    }
+
+    void Logger::writeSync(int _level, const char *text, size_t length)
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+        lock_guard<mutex> lock(sync_lock);
+        string line;
+        format(sync_time, line, _level, now_usec(), -1, text, length);
+        if (::write(fd, line.c_str(), line.length()) < 0)
+        {
+            swSysError("write(%s) failed.", file.c_str());
+        }
+    }
+
+    void Logger::format(TimeCache &cache, string &out, int _level, int64_t usec, int worker_id, const char *text, size_t length)
+    {
+        time_t second = (time_t) (usec / 1000000);
+        if (second != cache.second)
+        {
+            struct tm tm;
+            localtime_r(&second, &tm);
+            strftime(cache.str, sizeof(cache.str), "%Y-%m-%d %H:%M:%S", &tm);
+            cache.second = second;
+        }
+        char prefix[96];
+        const char *level_name = _level >= 0 && _level <= SW_LOG_ERROR ? level_names[_level] : "LOG";
+        int n;
+        if (worker_id < 0)
+        {
+            n = snprintf(prefix, sizeof(prefix), "[%s.%06d *%d]\t%s\t", cache.str, (int) (usec % 1000000),
+                         getpid(), level_name);
+        }
+        else
+        {
+            n = snprintf(prefix, sizeof(prefix), "[%s.%06d #%d]\t%s\t", cache.str, (int) (usec % 1000000),
+                         worker_id, level_name);
+        }
+        out.append(prefix, n);
+        out.append(text, length);
+        out.append("\n", 1);
+    }
+
+    bool Logger::drain(int worker_id, Ring *ring, string &batch)
+    {
+        uint64_t read_pos = ring->read_pos;
+        uint64_t write_pos = __atomic_load_n(&ring->write_pos, __ATOMIC_ACQUIRE);
+        if (read_pos == write_pos && ring->dropped == 0)
+        {
+            return false;
+        }
+
+        while (read_pos < write_pos)
+        {
+            Record *record = (Record *) (ring->data + (read_pos & (ring_size - 1)));
+            if (record->type == RECORD_TEXT)
+            {
+                format(writer_time, batch, record->level, record->usec, worker_id, record->text, record->text_length);
+            }
+            read_pos += record->length;
+            if (batch.length() >= SW_CPP_LOG_BATCH_SIZE)
+            {
+                //give the space back before the write, producers do not wait for the disk
+                __atomic_store_n(&ring->read_pos, read_pos, __ATOMIC_RELEASE);
+                flush(batch);
+            }
+        }
+        __atomic_store_n(&ring->read_pos, read_pos, __ATOMIC_RELEASE);
+
+        int64_t dropped = __sync_lock_test_and_set(&ring->dropped, 0);
+        if (dropped > 0)
+        {
+            char text[64];
+            int n = snprintf(text, sizeof(text), "%ld records dropped, log ring is full", (long) dropped);
+            format(writer_time, batch, SW_LOG_WARNING, now_usec(), worker_id, text, n);
+        }
+        return true;
+    }
+
+    void Logger::flush(string &batch)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        lock_guard<mutex> lock(sync_lock);
+        if (::write(fd, batch.c_str(), batch.length()) < 0)
+        {
+            swSysError("write(%s) failed.", file.c_str());
+        }
+        batch.clear();
+    }
+
+    void Logger::run(void)
+    {
+        string batch;
+        batch.reserve(SW_CPP_LOG_BATCH_SIZE * 2);
+
+        while (true)
+        {
+            bool stopping = !running;
+            bool busy = false;
+            for (int i = 0; i < ring_num; i++)
+            {
+                if (drain(i, getRing(i), batch))
+                {
+                    busy = true;
+                }
+            }
+            flush(batch);
+            //the last pass after stop() has emptied the rings
+            if (stopping)
+            {
+                break;
+            }
+            if (!busy)
+            {
+                usleep(SW_CPP_LOG_FLUSH_INTERVAL * 1000);
+            }
+        }
+    }
+}
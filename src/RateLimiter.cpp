@@ -0,0 +1,176 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "RateLimiter.hpp"
+
+#include <time.h>
+
+namespace swoole
+{
+    static inline double now_sec(void)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    RateLimiter::RateLimiter(size_t ip_rows) :
+            ips(ip_rows)
+    {
+        conn_rate = 0;
+        conn_burst = 0;
+        ip_rate = 0;
+        ip_burst = 0;
+        rejected = NULL;
+    }
+
+    RateLimiter::~RateLimiter()
+    {
+        if (rejected)
+        {
+            sw_shm_free((void *) rejected);
+        }
+    }
+
+    void RateLimiter::setConnectionLimit(double rate, double burst)
+    {
+        conn_rate = rate;
+        conn_burst = burst < 1 ? 1 : burst;
+    }
+
+    void RateLimiter::setIpLimit(double rate, double burst)
+    {
+        ip_rate = rate;
+        ip_burst = burst < 1 ? 1 : burst;
+    }
+
+    bool RateLimiter::create(size_t max_connection)
+    {
+        rejected = (sw_atomic_long_t *) sw_shm_malloc(sizeof(sw_atomic_long_t));
+        if (rejected == NULL)
+        {
+            swWarn("sw_shm_malloc(%ld) failed.", sizeof(sw_atomic_long_t));
+            return false;
+        }
+        *rejected = 0;
+        if (conn_rate > 0)
+        {
+            Bucket bucket = {0, 0, 0};
+            buckets.resize(max_connection + 1, bucket);
+        }
+        if (ip_rate > 0)
+        {
+            //theoretical arrival time of the next event (GCRA), one column does the whole bucket
+            ips.column("tat", Table::TYPE_FLOAT);
+            return ips.create();
+        }
+        return true;
+    }
+
+    bool RateLimiter::allow(swConnection *conn)
+    {
+        double now = now_sec();
+        if (conn_rate > 0 && (size_t) conn->fd < buckets.size())
+        {
+            Bucket &bucket = buckets[conn->fd];
+            //a new connection on a reused fd starts with a full bucket
+            if (bucket.session_id != conn->session_id)
+            {
+                bucket.session_id = conn->session_id;
+                bucket.tokens = conn_burst;
+                bucket.stamp = now;
+            }
+            bucket.tokens += (now - bucket.stamp) * conn_rate;
+            if (bucket.tokens > conn_burst)
+            {
+                bucket.tokens = conn_burst;
+            }
+            bucket.stamp = now;
+            if (bucket.tokens < 1)
+            {
+                sw_atomic_fetch_add(rejected, 1);
+                return false;
+            }
+            bucket.tokens -= 1;
+        }
+        if (ip_rate > 0 && !allowIp(conn, now))
+        {
+            sw_atomic_fetch_add(rejected, 1);
+            return false;
+        }
+        return true;
+    }
+
+    bool RateLimiter::allowIp(swConnection *conn, double now)
+    {
+        const char *ip = swConnection_get_ip(conn);
+        bool allowed = true;
+        //check and take the token under the row lock, the reactor threads share the row
+        auto take = [&](TableRow &row)
+        {
+            double tat = 0;
+            row.get("tat", tat);
+            if (tat < now)
+            {
+                tat = now;
+            }
+            //bursts of ip_burst events are allowed ahead of the steady rate
+            if (tat - now > (ip_burst - 1) / ip_rate)
+            {
+                allowed = false;
+                return;
+            }
+            row.set("tat", tat + 1 / ip_rate);
+        };
+        if (!ips.update(ip, strlen(ip), take))
+        {
+            expireIps(now);
+            //a table still full does not lock anybody out
+            ips.update(ip, strlen(ip), take);
+        }
+        return allowed;
+    }
+
+    /**
+     * A row whose tat has passed holds a full bucket, the same as no row at all.
+     * At most one scan per second in each thread, a table full of active IPs would scan on every event.
+     */
+    void RateLimiter::expireIps(double now)
+    {
+        static thread_local double last_scan = 0;
+        if (now - last_scan < 1)
+        {
+            return;
+        }
+        last_scan = now;
+
+        //each() must not write the table, the rows are removed after the scan
+        vector<string> expired;
+        ips.each([&](const char *key, TableRow &row)
+        {
+            double tat = 0;
+            if (row.get("tat", tat) && tat < now)
+            {
+                expired.push_back(key);
+            }
+            return true;
+        });
+        for (auto iter = expired.begin(); iter != expired.end(); iter++)
+        {
+            ips.del(*iter);
+        }
+    }
+}
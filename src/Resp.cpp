@@ -0,0 +1,573 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+
+#include "Resp.hpp"
+
+namespace swoole
+{
+    //an inline command (telnet, redis-cli without a connection) is one line
+    static const size_t RESP_MAX_INLINE = 64 * 1024;
+
+    enum
+    {
+        //a row that was created but not written yet
+        VALUE_NONE = 0,
+        VALUE_STRING = 1,
+        VALUE_INTEGER = 2,
+    };
+
+    static bool parse_integer(const string &str, long &value)
+    {
+        char *end;
+        errno = 0;
+        value = strtol(str.c_str(), &end, 10);
+        return !str.empty() && *end == '\0' && errno != ERANGE;
+    }
+
+    void RespReply::status(const char *str)
+    {
+        out.append("+", 1);
+        out.append(str);
+        out.append("\r\n", 2);
+    }
+
+    void RespReply::error(const char *str)
+    {
+        out.append("-", 1);
+        out.append(str);
+        out.append("\r\n", 2);
+    }
+
+    void RespReply::integer(long value)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), ":%ld\r\n", value);
+        out.append(buf, n);
+    }
+
+    void RespReply::bulk(const char *data, size_t length)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "$%lu\r\n", (unsigned long) length);
+        out.append(buf, n);
+        out.append(data, length);
+        out.append("\r\n", 2);
+    }
+
+    void RespReply::null(void)
+    {
+        out.append("$-1\r\n", 5);
+    }
+
+    void RespReply::array(size_t num)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "*%lu\r\n", (unsigned long) num);
+        out.append(buf, n);
+    }
+
+    //a number line at p, 0 while it is incomplete, -1 if it is not a number
+    static int read_number(const char *&p, const char *end, long *value)
+    {
+        const char *cr = (const char *) memchr(p, '\r', end - p);
+        if (cr == NULL || cr + 1 >= end)
+        {
+            //number lines are short, a long one without CRLF is garbage
+            return end - p > 32 ? -1 : 0;
+        }
+        if (cr[1] != '\n' || cr == p)
+        {
+            return -1;
+        }
+        const char *q = p;
+        bool negative = *q == '-';
+        if (negative && ++q == cr)
+        {
+            return -1;
+        }
+        long n = 0;
+        for (; q < cr; q++)
+        {
+            if (*q < '0' || *q > '9' || n > SW_CPP_RESP_MAX_LENGTH)
+            {
+                return -1;
+            }
+            n = n * 10 + (*q - '0');
+        }
+        *value = negative ? -n : n;
+        p = cr + 2;
+        return 1;
+    }
+
+    static ssize_t parse_inline(const char *data, size_t length, vector<RespSlice> &argv)
+    {
+        const char *eol = (const char *) memchr(data, '\n', length);
+        if (eol == NULL)
+        {
+            return length > RESP_MAX_INLINE ? -1 : 0;
+        }
+        const char *end = eol;
+        if (end > data && end[-1] == '\r')
+        {
+            end--;
+        }
+        const char *p = data;
+        while (p < end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t'))
+            {
+                p++;
+            }
+            const char *start = p;
+            while (p < end && *p != ' ' && *p != '\t')
+            {
+                p++;
+            }
+            if (p > start)
+            {
+                RespSlice arg = {start, (size_t) (p - start)};
+                argv.push_back(arg);
+            }
+        }
+        return eol + 1 - data;
+    }
+
+    ssize_t RespServer::parse(const char *data, size_t length, vector<RespSlice> &argv)
+    {
+        argv.clear();
+        if (length == 0)
+        {
+            return 0;
+        }
+        if (data[0] != '*')
+        {
+            return parse_inline(data, length, argv);
+        }
+
+        const char *p = data + 1;
+        const char *end = data + length;
+        long num;
+        int ret = read_number(p, end, &num);
+        if (ret <= 0)
+        {
+            return ret;
+        }
+        if (num > SW_CPP_RESP_MAX_ARGS)
+        {
+            return -1;
+        }
+        for (long i = 0; i < num; i++)
+        {
+            if (p >= end)
+            {
+                return 0;
+            }
+            if (*p != '$')
+            {
+                return -1;
+            }
+            p++;
+            long size;
+            ret = read_number(p, end, &size);
+            if (ret <= 0)
+            {
+                return ret;
+            }
+            if (size < 0 || size > SW_CPP_RESP_MAX_LENGTH)
+            {
+                return -1;
+            }
+            //the body is skipped by its length, never scanned
+            if ((size_t) (end - p) < (size_t) size + 2)
+            {
+                return 0;
+            }
+            if (p[size] != '\r' || p[size + 1] != '\n')
+            {
+                return -1;
+            }
+            RespSlice arg = {p, (size_t) size};
+            argv.push_back(arg);
+            p += size + 2;
+        }
+        return p - data;
+    }
+
+    RespServer::RespServer(Server *_server, Table *_table) :
+            server(_server), table(_table)
+    {
+        setCommand("ping", -1, [](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            if (argv.size() > 1)
+            {
+                reply.bulk(argv[1].data, argv[1].length);
+            }
+            else
+            {
+                reply.status("PONG");
+            }
+        });
+        setCommand("echo", 2, [](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            reply.bulk(argv[1].data, argv[1].length);
+        });
+        //redis-cli asks for the command docs when it connects
+        setCommand("command", -1, [](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            reply.array(0);
+        });
+        if (table)
+        {
+            defineCacheCommands();
+        }
+    }
+
+    bool RespServer::defineColumns(Table &table, size_t value_size)
+    {
+        return table.column("value", Table::TYPE_STRING, value_size) && table.column("num", Table::TYPE_INT, 8)
+                && table.column("type", Table::TYPE_INT, 1);
+    }
+
+    bool RespServer::bind(ListenPort *port)
+    {
+        if (port == NULL)
+        {
+            return false;
+        }
+        port->setTcpNodelay(true);
+        port->setHandler(this);
+        return true;
+    }
+
+    void RespServer::setCommand(const string &_name, int arity, const Command &command)
+    {
+        string lower = _name;
+        for (size_t i = 0; i < lower.length(); i++)
+        {
+            lower[i] = tolower(lower[i]);
+        }
+        CommandEntry entry = {arity, command};
+        commands[lower] = entry;
+    }
+
+    void RespServer::getValue(const RespSlice &_key, RespReply &reply)
+    {
+        const string &k = toKey(_key);
+        long type;
+        if (!table->get(k, "type", type) || type == VALUE_NONE)
+        {
+            reply.null();
+            return;
+        }
+        if (type == VALUE_INTEGER)
+        {
+            long num = 0;
+            table->get(k, "num", num);
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%ld", num);
+            reply.bulk(buf, n);
+            return;
+        }
+        string value;
+        if (table->get(k, "value", value))
+        {
+            reply.bulk(value);
+        }
+        else
+        {
+            reply.null();
+        }
+    }
+
+    void RespServer::incrValue(const RespSlice &_key, long incrby, RespReply &reply)
+    {
+        const char *error = NULL;
+        long num = 0;
+        //read, convert and write under the row lock, the workers share the row
+        bool found = table->update(toKey(_key), [&](TableRow &row)
+        {
+            long type = VALUE_NONE;
+            row.get("type", type);
+            if (type == VALUE_STRING)
+            {
+                //a number that came in by SET becomes an integer once
+                string value;
+                row.get("value", value);
+                if (!parse_integer(value, num))
+                {
+                    error = "ERR value is not an integer or out of range";
+                    return;
+                }
+            }
+            else if (type == VALUE_INTEGER)
+            {
+                row.get("num", num);
+            }
+            if ((incrby > 0 && num > LONG_MAX - incrby) || (incrby < 0 && num < LONG_MIN - incrby))
+            {
+                error = "ERR increment or decrement would overflow";
+                return;
+            }
+            num += incrby;
+            row.set("num", num);
+            row.set("type", (long) VALUE_INTEGER);
+        });
+        if (!found)
+        {
+            reply.error("ERR cache is full");
+        }
+        else if (error)
+        {
+            reply.error(error);
+        }
+        else
+        {
+            reply.integer(num);
+        }
+    }
+
+    void RespServer::incrArgument(const RespSlice &_key, const RespSlice &arg, bool negative, RespReply &reply)
+    {
+        long incrby;
+        if (!parse_integer(arg.str(), incrby) || (negative && incrby == LONG_MIN))
+        {
+            reply.error("ERR value is not an integer or out of range");
+            return;
+        }
+        incrValue(_key, negative ? -incrby : incrby, reply);
+    }
+
+    void RespServer::defineCacheCommands(void)
+    {
+        setCommand("get", 2, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            getValue(argv[1], reply);
+        });
+        setCommand("mget", -2, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            reply.array(argv.size() - 1);
+            for (size_t i = 1; i < argv.size(); i++)
+            {
+                getValue(argv[i], reply);
+            }
+        });
+        setCommand("set", 3, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            const string &k = toKey(argv[1]);
+            bool stored = false;
+            bool created = false;
+            //value and type in one step, GET never sees the one without the other
+            bool found = table->update(k, [&](TableRow &row)
+            {
+                long type = VALUE_NONE;
+                row.get("type", type);
+                created = type == VALUE_NONE;
+                stored = row.set("value", argv[2].str()) && row.set("type", (long) VALUE_STRING);
+            });
+            if (found && stored)
+            {
+                reply.status("OK");
+                return;
+            }
+            //a value that is too long must not leave an empty row behind
+            if (found && created)
+            {
+                table->del(k);
+            }
+            reply.error("ERR cache is full, or the key or value is too long");
+        });
+        setCommand("del", -2, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            long n = 0;
+            for (size_t i = 1; i < argv.size(); i++)
+            {
+                if (table->del(toKey(argv[i])))
+                {
+                    n++;
+                }
+            }
+            reply.integer(n);
+        });
+        setCommand("exists", -2, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            long n = 0;
+            for (size_t i = 1; i < argv.size(); i++)
+            {
+                if (table->exists(toKey(argv[i])))
+                {
+                    n++;
+                }
+            }
+            reply.integer(n);
+        });
+        setCommand("incr", 2, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            incrValue(argv[1], 1, reply);
+        });
+        setCommand("decr", 2, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            incrValue(argv[1], -1, reply);
+        });
+        setCommand("incrby", 3, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            incrArgument(argv[1], argv[2], false, reply);
+        });
+        setCommand("decrby", 3, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            incrArgument(argv[1], argv[2], true, reply);
+        });
+        setCommand("dbsize", 1, [this](int fd, const vector<RespSlice> &argv, RespReply &reply)
+        {
+            reply.integer((long) table->count());
+        });
+    }
+
+    //false when the connection is to be closed
+    bool RespServer::execute(int fd)
+    {
+        name.assign(argv[0].data, argv[0].length);
+        for (size_t i = 0; i < name.length(); i++)
+        {
+            name[i] = tolower(name[i]);
+        }
+        if (name == "quit")
+        {
+            reply.status("OK");
+            return false;
+        }
+
+        char error[128];
+        auto iter = commands.find(name);
+        if (iter == commands.end())
+        {
+            snprintf(error, sizeof(error), "ERR unknown command '%.64s'", name.c_str());
+            reply.error(error);
+            return true;
+        }
+        int arity = iter->second.arity;
+        int argc = (int) argv.size();
+        if ((arity > 0 && argc != arity) || (arity < 0 && argc < -arity))
+        {
+            snprintf(error, sizeof(error), "ERR wrong number of arguments for '%.64s' command", name.c_str());
+            reply.error(error);
+            return true;
+        }
+        iter->second.handler(fd, argv, reply);
+        return true;
+    }
+
+    void RespServer::flush(int fd)
+    {
+        const string &out = reply.buffer();
+        if (!out.empty())
+        {
+            server->send(fd, out.data(), (int) out.length());
+            reply.clear();
+        }
+    }
+
+    void RespServer::onReceive(int fd, const DataBuffer &data)
+    {
+        int index = server->getConnectionIndex(fd);
+        if (index < 0)
+        {
+            return;
+        }
+        if ((size_t) index >= buffers.size())
+        {
+            buffers.resize(index + 1);
+        }
+        string &buffer = buffers[index];
+
+        //parse in place, unless a command is already half way in the buffer
+        bool buffered = !buffer.empty();
+        if (buffered)
+        {
+            buffer.append((const char *) data.buffer, data.length);
+        }
+        const char *input = buffered ? buffer.data() : (const char *) data.buffer;
+        size_t length = buffered ? buffer.length() : data.length;
+
+        size_t offset = 0;
+        bool keep = true;
+        while (offset < length)
+        {
+            ssize_t n = parse(input + offset, length - offset, argv);
+            if (n == 0)
+            {
+                break;
+            }
+            if (n < 0)
+            {
+                reply.error("ERR Protocol error");
+                keep = false;
+                break;
+            }
+            offset += n;
+            if (!argv.empty() && !execute(fd))
+            {
+                keep = false;
+                break;
+            }
+            if (reply.buffer().length() >= SW_CPP_RESP_FLUSH_SIZE)
+            {
+                flush(fd);
+            }
+        }
+        flush(fd);
+
+        if (keep && length - offset > SW_CPP_RESP_MAX_LENGTH)
+        {
+            reply.error("ERR command is too long");
+            flush(fd);
+            keep = false;
+        }
+        if (!keep)
+        {
+            string().swap(buffer);
+            server->close(fd);
+            return;
+        }
+        if (buffered)
+        {
+            buffer.erase(0, offset);
+        }
+        else if (offset < length)
+        {
+            buffer.assign(input + offset, length - offset);
+        }
+        //a big command does not pin its memory to the connection
+        if (buffer.empty() && buffer.capacity() > SW_CPP_RESP_FLUSH_SIZE)
+        {
+            string().swap(buffer);
+        }
+    }
+
+    void RespServer::onConnect(int fd)
+    {
+        int index = server->getConnectionIndex(fd);
+        if (index >= 0 && (size_t) index < buffers.size())
+        {
+            string().swap(buffers[index]);
+        }
+    }
+
+    void RespServer::onClose(int fd)
+    {
+        onConnect(fd);
+    }
+}
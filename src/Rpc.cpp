@@ -0,0 +1,382 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+
+#include "Rpc.hpp"
+
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+
+namespace swoole
+{
+    static unordered_map<int, RpcClient *> clients;
+
+    bool RpcHandler::bind(ListenPort *port, uint32_t max_length)
+    {
+        if (!port->setLengthCheck('N', 0, sizeof(RpcHeader), max_length + sizeof(RpcHeader)))
+        {
+            return false;
+        }
+        port->setTcpNodelay(true);
+        port->setHandler(this);
+        return true;
+    }
+
+    void RpcHandler::onReceive(int fd, const DataBuffer &data)
+    {
+        if (data.length < sizeof(RpcHeader))
+        {
+            return;
+        }
+        RpcHeader header;
+        memcpy(&header, data.buffer, sizeof(header));
+        //the body is passed in place, no copy
+        DataBuffer body;
+        body.buffer = (char *) data.buffer + sizeof(header);
+        body.length = data.length - sizeof(header);
+        onRequest(fd, ntohl(header.request_id), ntohs(header.method), body);
+    }
+
+    bool RpcHandler::respond(int fd, uint32_t request_id, const DataBuffer &data, uint16_t status)
+    {
+        //one send per response, the frame buffer is reused by the thread
+        static thread_local string frame;
+        RpcHeader header;
+        header.length = htonl((uint32_t) data.length);
+        header.request_id = htonl(request_id);
+        header.method = 0;
+        header.status = htons(status);
+        frame.assign((const char *) &header, sizeof(header));
+        if (data.length > 0)
+        {
+            frame.append((const char *) data.buffer, data.length);
+        }
+        return server->send(fd, frame.data(), (int) frame.length());
+    }
+
+    RpcClient::RpcClient(const string &_host, int _port) :
+            host(_host), port(_port)
+    {
+        fd = -1;
+        generation = 0;
+        max_length = SW_CPP_RPC_MAX_LENGTH;
+        next_id = 1;
+        timeout = 0;
+        ticks = 0;
+        send_offset = 0;
+        timer = NULL;
+    }
+
+    RpcClient::~RpcClient()
+    {
+        close();
+        delete timer;
+    }
+
+    bool RpcClient::connect(double _timeout)
+    {
+        if (fd >= 0)
+        {
+            return true;
+        }
+
+        struct addrinfo hints;
+        struct addrinfo *result;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        char service[16];
+        snprintf(service, sizeof(service), "%d", port);
+        int ret = getaddrinfo(host.c_str(), service, &hints, &result);
+        if (ret != 0)
+        {
+            swWarn("getaddrinfo(%s) failed, %s.", host.c_str(), gai_strerror(ret));
+            return false;
+        }
+
+        int sock = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0)
+        {
+            swSysError("socket() failed.");
+            freeaddrinfo(result);
+            return false;
+        }
+        ret = ::connect(sock, result->ai_addr, result->ai_addrlen);
+        freeaddrinfo(result);
+        if (ret < 0 && errno == EINPROGRESS)
+        {
+            struct pollfd event;
+            event.fd = sock;
+            event.events = POLLOUT;
+            ret = poll(&event, 1, (int) (_timeout * 1000));
+            if (ret == 0)
+            {
+                errno = ETIMEDOUT;
+                ret = -1;
+            }
+            else if (ret > 0)
+            {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len);
+                errno = error;
+                ret = error == 0 ? 0 : -1;
+            }
+        }
+        if (ret < 0)
+        {
+            swSysError("connect(%s:%d) failed.", host.c_str(), port);
+            ::close(sock);
+            return false;
+        }
+        int nodelay = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        check_reactor();
+        swReactor *reactor = SwooleG.main_reactor;
+        reactor->setHandle(reactor, FD_RPC_CLIENT | SW_EVENT_READ, RpcClient::onReactorRead);
+        reactor->setHandle(reactor, FD_RPC_CLIENT | SW_EVENT_WRITE, RpcClient::onReactorWrite);
+        reactor->setHandle(reactor, FD_RPC_CLIENT | SW_EVENT_ERROR, RpcClient::onReactorRead);
+        if (reactor->add(reactor, sock, FD_RPC_CLIENT | SW_EVENT_READ) < 0)
+        {
+            ::close(sock);
+            return false;
+        }
+        fd = sock;
+        clients[fd] = this;
+        if (timeout > 0 && timer == NULL)
+        {
+            timer = new ExpireTimer(this);
+        }
+        return true;
+    }
+
+    void RpcClient::setTimeout(int msec)
+    {
+        timeout = msec;
+        if (timeout > 0 && timer == NULL && fd >= 0)
+        {
+            timer = new ExpireTimer(this);
+        }
+    }
+
+    uint32_t RpcClient::call(uint16_t method, const DataBuffer &data, const Callback &callback)
+    {
+        if (fd < 0)
+        {
+            return 0;
+        }
+        uint32_t request_id = next_id++;
+        if (next_id == 0)
+        {
+            next_id = 1;
+        }
+
+        RpcHeader header;
+        header.length = htonl((uint32_t) data.length);
+        header.request_id = htonl(request_id);
+        header.method = htons(method);
+        header.status = 0;
+        //the write event flushes everything queued meanwhile
+        bool idle = send_offset == send_buffer.length();
+        send_buffer.append((const char *) &header, sizeof(header));
+        if (data.length > 0)
+        {
+            send_buffer.append((const char *) data.buffer, data.length);
+        }
+        if (idle)
+        {
+            swReactor *reactor = SwooleG.main_reactor;
+            reactor->set(reactor, fd, FD_RPC_CLIENT | SW_EVENT_READ | SW_EVENT_WRITE);
+        }
+
+        pending[request_id] = callback;
+        if (timeout > 0)
+        {
+            Deadline deadline = {request_id, ticks + (timeout + SW_CPP_RPC_TIMER_INTERVAL - 1) / SW_CPP_RPC_TIMER_INTERVAL};
+            deadlines.push_back(deadline);
+        }
+        return request_id;
+    }
+
+    void RpcClient::close()
+    {
+        if (fd >= 0)
+        {
+            swReactor *reactor = SwooleG.main_reactor;
+            reactor->del(reactor, fd);
+            clients.erase(fd);
+            ::close(fd);
+            fd = -1;
+        }
+        generation++;
+        send_buffer.clear();
+        send_offset = 0;
+        recv_buffer.clear();
+        deadlines.clear();
+
+        unordered_map<uint32_t, Callback> failed;
+        failed.swap(pending);
+        DataBuffer empty;
+        for (auto iter = failed.begin(); iter != failed.end(); iter++)
+        {
+            iter->second(RPC_CLOSED, empty);
+        }
+    }
+
+    bool RpcClient::write(void)
+    {
+        while (send_offset < send_buffer.length())
+        {
+            ssize_t n = ::send(fd, send_buffer.data() + send_offset, send_buffer.length() - send_offset, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN)
+                {
+                    //keep the buffer from growing under steady load
+                    if (send_offset > send_buffer.length() / 2)
+                    {
+                        send_buffer.erase(0, send_offset);
+                        send_offset = 0;
+                    }
+                    return true;
+                }
+                swSysError("send(%s:%d) failed.", host.c_str(), port);
+                return false;
+            }
+            send_offset += n;
+        }
+        send_buffer.clear();
+        send_offset = 0;
+        swReactor *reactor = SwooleG.main_reactor;
+        reactor->set(reactor, fd, FD_RPC_CLIENT | SW_EVENT_READ);
+        return true;
+    }
+
+    bool RpcClient::read(void)
+    {
+        char buf[65536];
+        while (true)
+        {
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN)
+                {
+                    break;
+                }
+                swSysError("recv(%s:%d) failed.", host.c_str(), port);
+                return false;
+            }
+            if (n == 0)
+            {
+                return false;
+            }
+            recv_buffer.append(buf, n);
+            if ((size_t) n < sizeof(buf))
+            {
+                break;
+            }
+        }
+
+        size_t offset = 0;
+        uint32_t _generation = generation;
+        while (recv_buffer.length() - offset >= sizeof(RpcHeader))
+        {
+            RpcHeader header;
+            memcpy(&header, recv_buffer.data() + offset, sizeof(header));
+            uint32_t length = ntohl(header.length);
+            if (length > max_length)
+            {
+                swWarn("RPC frame of %u bytes from %s:%d is too large.", length, host.c_str(), port);
+                return false;
+            }
+            if (recv_buffer.length() - offset < sizeof(header) + length)
+            {
+                break;
+            }
+            DataBuffer body;
+            body.buffer = (char *) recv_buffer.data() + offset + sizeof(header);
+            body.length = length;
+            offset += sizeof(header) + length;
+
+            auto iter = pending.find(ntohl(header.request_id));
+            //timed out already
+            if (iter == pending.end())
+            {
+                continue;
+            }
+            Callback callback = std::move(iter->second);
+            pending.erase(iter);
+            callback(ntohs(header.status), body);
+            //closed by the callback, maybe connected again with a new buffer
+            if (generation != _generation)
+            {
+                return true;
+            }
+        }
+        recv_buffer.erase(0, offset);
+        return true;
+    }
+
+    void RpcClient::expire(void)
+    {
+        ticks++;
+        while (!deadlines.empty() && deadlines.front().tick <= ticks)
+        {
+            uint32_t request_id = deadlines.front().request_id;
+            deadlines.pop_front();
+            auto iter = pending.find(request_id);
+            if (iter == pending.end())
+            {
+                continue;
+            }
+            Callback callback = std::move(iter->second);
+            pending.erase(iter);
+            callback(RPC_TIMEOUT, DataBuffer());
+        }
+    }
+
+    int RpcClient::onReactorRead(swReactor *reactor, swEvent *event)
+    {
+        auto iter = clients.find(event->fd);
+        if (iter != clients.end() && !iter->second->read())
+        {
+            iter->second->close();
+        }
+        return SW_OK;
+    }
+
+    int RpcClient::onReactorWrite(swReactor *reactor, swEvent *event)
+    {
+        auto iter = clients.find(event->fd);
+        if (iter != clients.end() && !iter->second->write())
+        {
+            iter->second->close();
+        }
+        return SW_OK;
+    }
+}
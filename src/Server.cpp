@@ -15,17 +15,48 @@
 */
 
 #include "Server.hpp"
+#include "AsyncIO.hpp"
 #include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <dirent.h>
 #include <swoole/Server.h>
 
 namespace swoole
 {
-    swString *_callback_buffer;
+    thread_local swString *_callback_buffer = NULL;
+    static swString *sendfile_buffer = NULL;
     Server::Server(string _host, int _port, int _mode, int _type)
     {
         host = _host;
         port = _port;
         mode = _mode;
+        events = 0;
+        reuse_port = false;
+        buffer_high_watermark = 0;
+        buffer_low_watermark = 0;
+        contexts = NULL;
+        channel_capacity = 0;
+        task_thread_num = 0;
+        task_pool = NULL;
+        logger = NULL;
+        idle_timeout = 0;
+        idle_wheel = NULL;
+        rate_limiter = NULL;
+        compress_level = Z_DEFAULT_COMPRESSION;
+        max_tasking = 0;
+        max_worker_tasks = 0;
+        max_output_bytes = 0;
+        worker_tasks = 0;
+        shed_count = 0;
+        worker_counters = NULL;
+        admin_handler = NULL;
+        reload_state = NULL;
+        reload_timeout = SW_CPP_RELOAD_TIMEOUT;
+        compress_min_length = 0;
+        channel_slot_size = 0;
 
         swServer_init(&serv);
 
@@ -68,20 +99,162 @@ namespace swoole
         events = _events;
     }
 
-    bool Server::listen(string host, int port, int type)
+    void Server::setReusePort(bool enable)
+    {
+        reuse_port = enable;
+    }
+
+    void Server::setAffinity(const Affinity &_affinity)
+    {
+        affinity = _affinity;
+    }
+
+    void Server::setBufferWatermark(size_t high, size_t low)
+    {
+        buffer_high_watermark = high;
+        buffer_low_watermark = low;
+    }
+
+    size_t Server::pendingBytes(int fd)
+    {
+        swConnection *conn = swServer_connection_verify(&serv, fd);
+        if (!conn)
+        {
+            return 0;
+        }
+        //the output buffer lives in this process
+        if (serv.factory_mode == SW_MODE_SINGLE)
+        {
+            return conn->out_buffer ? conn->out_buffer->length : 0;
+        }
+        //the reactor thread only shares the watermark state with the workers
+        return conn->high_watermark ? buffer_high_watermark : 0;
+    }
+
+    bool Server::isBufferFull(int fd)
+    {
+        swConnection *conn = swServer_connection_verify(&serv, fd);
+        return conn && conn->high_watermark;
+    }
+
+    /**
+     * Bind a new SO_REUSEPORT socket to the address of the port.
+     */
+    static int reuseport_socket(swListenPort *ls, bool listening, int backlog)
+    {
+        int domain;
+        if (ls->type == SW_SOCK_TCP)
+        {
+            domain = AF_INET;
+        }
+        else if (ls->type == SW_SOCK_TCP6)
+        {
+            domain = AF_INET6;
+        }
+        else
+        {
+            return SW_ERR;
+        }
+
+        int sock = socket(domain, SOCK_STREAM, 0);
+        if (sock < 0)
+        {
+            swSysError("socket() failed.");
+            return SW_ERR;
+        }
+        int option = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) < 0)
+        {
+            swSysError("setsockopt(SO_REUSEPORT) failed.");
+            ::close(sock);
+            return SW_ERR;
+        }
+
+        int ret;
+        if (domain == AF_INET)
+        {
+            struct sockaddr_in addr;
+            bzero(&addr, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(ls->port);
+            inet_pton(AF_INET, ls->host, &addr.sin_addr);
+            ret = bind(sock, (struct sockaddr *) &addr, sizeof(addr));
+        }
+        else
+        {
+            struct sockaddr_in6 addr;
+            bzero(&addr, sizeof(addr));
+            addr.sin6_family = AF_INET6;
+            addr.sin6_port = htons(ls->port);
+            inet_pton(AF_INET6, ls->host, &addr.sin6_addr);
+            ret = bind(sock, (struct sockaddr *) &addr, sizeof(addr));
+        }
+        if (ret < 0)
+        {
+            swSysError("bind(%s:%d) failed.", ls->host, ls->port);
+            ::close(sock);
+            return SW_ERR;
+        }
+        if (listening)
+        {
+            if (::listen(sock, backlog) < 0)
+            {
+                swSysError("listen(%s:%d) failed.", ls->host, ls->port);
+                ::close(sock);
+                return SW_ERR;
+            }
+            fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+        }
+        return sock;
+    }
+
+    /**
+     * Give every TCP port of this worker a private SO_REUSEPORT listener.
+     * dup2() keeps the fd number, so the port and connection bookkeeping of libswoole stay valid.
+     */
+    static void reuseport_worker_listen(swServer *serv, vector<swListenPort *> &ports)
+    {
+        swReactor *reactor = SwooleG.main_reactor;
+        for (auto iter = ports.begin(); iter != ports.end(); iter++)
+        {
+            swListenPort *ls = *iter;
+            int sock = reuseport_socket(ls, true, serv->backlog);
+            if (sock < 0)
+            {
+                continue;
+            }
+            reactor->del(reactor, ls->sock);
+            //take the inherited listener out of the SO_REUSEPORT group for every process
+            shutdown(ls->sock, SHUT_RD);
+            dup2(sock, ls->sock);
+            ::close(sock);
+            reactor->add(reactor, ls->sock, SW_FD_LISTEN);
+        }
+    }
+
+    ListenPort *Server::listen(string host, int port, int type)
     {
         auto ls = swServer_add_port(&serv, type, (char *) host.c_str(), port);
         if (ls == NULL)
         {
-            return false;
+            return NULL;
         }
         else
         {
             ports.push_back(ls);
-            return true;
+            ListenPort *handle = new ListenPort(ls);
+            listen_ports.push_back(handle);
+            return handle;
         }
     }
 
+    int Server::getConnectionIndex(int fd)
+    {
+        swSession *session = swServer_get_session(&serv, fd);
+        return session->fd;
+    }
+
     bool Server::send(int fd, const DataBuffer &data)
     {
         if (SwooleGS->start == 0)
@@ -108,6 +281,43 @@ namespace swoole
         return serv.send(&serv, fd, (char *) data, length) == SW_OK;
     }
 
+    /**
+     * Send one payload to many connections, the buffer is passed as-is to every connection
+     * without being copied into a DataBuffer. In SW_MODE_PROCESS each send goes to the reactor
+     * thread that owns the connection. Returns the number of connections it was queued for.
+     */
+    int Server::broadcast(const vector<int> &fds, const char *data, int length)
+    {
+        if (SwooleGS->start == 0)
+        {
+            return 0;
+        }
+        if (length <= 0)
+        {
+            return 0;
+        }
+        int count = 0;
+        for (auto fd = fds.begin(); fd != fds.end(); fd++)
+        {
+            //gone or closing, a list kept by the application lags behind onClose
+            swConnection *conn = swServer_connection_verify(&serv, *fd);
+            if (conn == NULL || conn->closed)
+            {
+                continue;
+            }
+            if (serv.send(&serv, *fd, (char *) data, length) == SW_OK)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    int Server::broadcast(const vector<int> &fds, const DataBuffer &data)
+    {
+        return broadcast(fds, (const char *) data.buffer, (int) data.length);
+    }
+
     bool Server::close(int fd, bool reset)
     {
         if (SwooleGS->start == 0)
@@ -159,9 +369,24 @@ namespace swoole
         task->info.from_id = SwooleWG.id;
         swTask_type(task) = 0;
 
-        if (data.length >= SW_IPC_MAX_SIZE - sizeof(task->info))
+        char *payload = (char *) data.buffer;
+        size_t length = data.length;
+
+        //inside a trace, the context goes in front of the data
+        string traced;
+        TraceContext *ctx = Tracer::current();
+        if (ctx)
+        {
+            traced.reserve(sizeof(*ctx) + data.length);
+            traced.append((char *) ctx, sizeof(*ctx));
+            traced.append((char *) data.buffer, data.length);
+            payload = (char *) traced.c_str();
+            length = traced.length();
+        }
+
+        if (length >= SW_IPC_MAX_SIZE - sizeof(task->info))
         {
-            if (swTaskWorker_large_pack(task, (char *) data.buffer, (int) data.length) < 0)
+            if (swTaskWorker_large_pack(task, payload, (int) length) < 0)
             {
                 swWarn("large task pack failed()");
                 return SW_ERR;
@@ -169,12 +394,31 @@ namespace swoole
         }
         else
         {
-            memcpy(task->data, (char *) data.buffer, data.length);
-            task->info.len = (uint16_t) data.length;
+            memcpy(task->data, payload, length);
+            task->info.len = (uint16_t) length;
+        }
+        if (ctx)
+        {
+            swTask_type(task) |= SW_CPP_TASK_TRACE;
         }
         return task->info.fd;
     }
 
+    /**
+     * Take the trace context off the front of the data, NULL if there is none.
+     */
+    static TraceContext *trace_unpack(swEventData *task, DataBuffer &data, TraceContext *ctx)
+    {
+        if (!(swTask_type(task) & SW_CPP_TASK_TRACE) || data.length < sizeof(*ctx))
+        {
+            return NULL;
+        }
+        memcpy(ctx, data.buffer, sizeof(*ctx));
+        data.buffer = (char *) data.buffer + sizeof(*ctx);
+        data.length -= sizeof(*ctx);
+        return ctx;
+    }
+
     static DataBuffer task_unpack(swEventData *task_result)
     {
         DataBuffer retval;
@@ -279,6 +523,555 @@ namespace swoole
         return SW_OK;
     }
 
+    /**
+     * The threads of the calling worker run the task, there is no task worker to pick.
+     */
+    static int check_pool_task_param(int dst_worker_id)
+    {
+        if (dst_worker_id != -1)
+        {
+            swWarn("dst_worker_id cannot be used with task threads.");
+            return SW_ERR;
+        }
+        if (!swIsWorker())
+        {
+            swWarn("The method can only be used in the worker process.");
+            return SW_ERR;
+        }
+        return SW_OK;
+    }
+
+    /**
+     * A task running on the thread pool of the worker, the data is copied once (moved by task(string &&)) and
+     * the result is moved back to the reactor without any pipe.
+     */
+    struct PoolTask
+    {
+        Server *server;
+        int id;
+        int src_worker_id;
+        string data;
+        string result;
+        bool finished;
+        bool traced;
+        TraceContext trace;
+    };
+
+    static thread_local PoolTask *current_pool_task = NULL;
+    //the task in a task worker has called finish()
+    static bool task_finished = false;
+
+    void Server::setTaskThreads(int num)
+    {
+        task_thread_num = num;
+    }
+
+    void Server::setLogger(Logger *_logger)
+    {
+        logger = _logger;
+    }
+
+    void Server::setIdleTimeout(int seconds)
+    {
+        idle_timeout = seconds;
+    }
+
+    void Server::setRateLimiter(RateLimiter *_limiter)
+    {
+        rate_limiter = _limiter;
+    }
+
+    typedef int (*factory_dispatch_handler)(swFactory *factory, swDispatchData *task);
+    //the dispatch of libswoole, the factory is created with the server and never replaced
+    static factory_dispatch_handler factory_dispatch = NULL;
+    static RateLimiter *dispatch_rate_limiter = NULL;
+
+    /**
+     * Runs in the reactor that read the data, a message costs one token: a whole packet,
+     * or the last piece of a large one.
+     */
+    static int rate_limit_dispatch(swFactory *factory, swDispatchData *task)
+    {
+        int type = task->data.info.type;
+        if (type == SW_EVENT_TCP || type == SW_EVENT_PACKAGE_END)
+        {
+            swConnection *conn = swServer_connection_get(SwooleG.serv, task->data.info.fd);
+            if (conn && !dispatch_rate_limiter->allow(conn))
+            {
+                //libswoole reads the EOF and closes as usual, the worker frees what it buffered in onClose
+                shutdown(task->data.info.fd, SHUT_RDWR);
+                return SW_OK;
+            }
+        }
+        return factory_dispatch(factory, task);
+    }
+
+    void Server::setTrace(const string &dir, double sample_rate)
+    {
+        Tracer::enable(dir, sample_rate);
+    }
+
+    void Server::setAdmission(size_t _max_tasking, size_t _max_worker_tasks, size_t _max_output_bytes)
+    {
+        max_tasking = _max_tasking;
+        max_worker_tasks = _max_worker_tasks;
+        max_output_bytes = _max_output_bytes;
+    }
+
+    /**
+     * A task worker that dies takes its tasks along, their results never come.
+     */
+    void Server::expireWorkerTasks(void)
+    {
+        time_t deadline = time(NULL) - SW_CPP_TASK_RESULT_TIMEOUT;
+        vector<int> expired;
+        for (auto iter = waiting_tasks.begin(); iter != waiting_tasks.end();)
+        {
+            if (iter->second < deadline)
+            {
+                expired.push_back(iter->first);
+                iter = waiting_tasks.erase(iter);
+                countWorkerTask(-1);
+            }
+            else
+            {
+                iter++;
+            }
+        }
+        //after the scan, onTaskDropped may dispatch new tasks
+        for (auto id = expired.begin(); id != expired.end(); id++)
+        {
+            onTaskDropped(*id);
+        }
+    }
+
+    bool Server::admit(int fd)
+    {
+        if (max_worker_tasks > 0 && worker_tasks >= max_worker_tasks)
+        {
+            expireWorkerTasks();
+        }
+        bool overloaded = (max_tasking > 0 && SwooleStats->tasking_num >= max_tasking)
+                || (max_worker_tasks > 0 && worker_tasks >= max_worker_tasks)
+                || (fd >= 0 && max_output_bytes > 0 && pendingBytes(fd) >= max_output_bytes);
+        if (overloaded)
+        {
+            shed_count++;
+            WorkerCounter *counter = getWorkerCounter();
+            if (counter)
+            {
+                sw_atomic_fetch_add(&counter->shed_count, 1);
+            }
+            SwooleG.error = SW_CPP_ERROR_SHED;
+            return false;
+        }
+        return true;
+    }
+
+    ServerStats Server::stats(void)
+    {
+        ServerStats retval;
+        retval.start_time = SwooleStats->start_time;
+        retval.connection_num = SwooleStats->connection_num;
+        retval.accept_count = SwooleStats->accept_count;
+        retval.close_count = SwooleStats->close_count;
+        retval.tasking_num = SwooleStats->tasking_num;
+        retval.request_count = SwooleStats->request_count;
+        retval.shed_count = 0;
+        retval.rate_limited = rate_limiter ? rate_limiter->getRejected() : 0;
+
+        int worker_num = serv.worker_num + SwooleG.task_worker_num;
+        for (int i = 0; i < worker_num; i++)
+        {
+            swWorker *worker = swServer_get_worker(&serv, (uint16_t) i);
+            WorkerStats ws;
+            ws.id = i;
+            ws.pid = worker ? worker->pid : 0;
+            ws.task_worker = i >= serv.worker_num;
+            ws.busy = worker && worker->status == SW_WORKER_BUSY;
+            ws.request_count = worker_counters ? worker_counters[i].request_count : 0;
+            ws.task_count = worker_counters ? worker_counters[i].task_count : 0;
+            ws.shed_count = worker_counters ? worker_counters[i].shed_count : 0;
+            retval.shed_count += ws.shed_count;
+            retval.workers.push_back(ws);
+        }
+        return retval;
+    }
+
+    static void append_metric(string &out, const char *name, const char *type, long value)
+    {
+        char line[256];
+        int n = snprintf(line, sizeof(line), "# TYPE %s %s\n%s %ld\n", name, type, name, value);
+        out.append(line, n);
+    }
+
+    static void append_worker_metric(string &out, const char *name, const WorkerStats &ws, long value)
+    {
+        char line[256];
+        int n = snprintf(line, sizeof(line), "%s{worker=\"%d\",type=\"%s\",pid=\"%d\"} %ld\n", name, ws.id,
+                         ws.task_worker ? "task" : "event", (int) ws.pid, value);
+        out.append(line, n);
+    }
+
+    string Server::statsText(void)
+    {
+        ServerStats s = stats();
+        string out;
+        append_metric(out, "swoole_start_time_seconds", "gauge", (long) s.start_time);
+        append_metric(out, "swoole_connections", "gauge", s.connection_num);
+        append_metric(out, "swoole_accepted_total", "counter", s.accept_count);
+        append_metric(out, "swoole_closed_total", "counter", s.close_count);
+        append_metric(out, "swoole_tasking", "gauge", s.tasking_num);
+        append_metric(out, "swoole_requests_total", "counter", s.request_count);
+        append_metric(out, "swoole_shed_total", "counter", s.shed_count);
+        append_metric(out, "swoole_rate_limited_total", "counter", s.rate_limited);
+
+        out.append("# TYPE swoole_worker_busy gauge\n");
+        for (auto iter = s.workers.begin(); iter != s.workers.end(); iter++)
+        {
+            append_worker_metric(out, "swoole_worker_busy", *iter, iter->busy ? 1 : 0);
+        }
+        out.append("# TYPE swoole_worker_requests_total counter\n");
+        for (auto iter = s.workers.begin(); iter != s.workers.end(); iter++)
+        {
+            append_worker_metric(out, "swoole_worker_requests_total", *iter, iter->request_count);
+        }
+        out.append("# TYPE swoole_worker_tasks_total counter\n");
+        for (auto iter = s.workers.begin(); iter != s.workers.end(); iter++)
+        {
+            append_worker_metric(out, "swoole_worker_tasks_total", *iter, iter->task_count);
+        }
+        out.append("# TYPE swoole_worker_shed_total counter\n");
+        for (auto iter = s.workers.begin(); iter != s.workers.end(); iter++)
+        {
+            append_worker_metric(out, "swoole_worker_shed_total", *iter, iter->shed_count);
+        }
+        return out;
+    }
+
+    /**
+     * Answers whatever arrives on the admin port with the stats and closes the connection.
+     */
+    class StatsHandler : public PortHandler
+    {
+    public:
+        StatsHandler(Server *_server) :
+                server(_server)
+        {
+        }
+
+        void onReceive(int fd, const DataBuffer &data)
+        {
+            string body = server->statsText();
+            if (data.length >= 4 && memcmp(data.buffer, "GET ", 4) == 0)
+            {
+                char header[128];
+                int n = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                 "Content-Length: %ld\r\nConnection: close\r\n\r\n", (long) body.length());
+                body.insert(0, header, n);
+            }
+            server->send(fd, body.c_str(), (int) body.length());
+            server->close(fd);
+        }
+
+    protected:
+        Server *server;
+    };
+
+    ListenPort *Server::setAdminPort(const string &admin_host, int admin_port)
+    {
+        ListenPort *port = listen(admin_host, admin_port, SW_SOCK_TCP);
+        if (port == NULL)
+        {
+            return NULL;
+        }
+        delete admin_handler;
+        admin_handler = new StatsHandler(this);
+        port->setHandler(admin_handler);
+        return port;
+    }
+
+    static inline int64_t now_msec(void)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+
+    bool Server::reload(bool only_task_workers)
+    {
+        if (SwooleGS->start == 0 || reload_state == NULL)
+        {
+            return false;
+        }
+        //a helper that was killed takes its rollout along, the flag it left behind means nothing
+        pid_t helper_pid = reload_state->helper_pid;
+        if (helper_pid <= 0 || kill(helper_pid, 0) < 0)
+        {
+            swWarn("the reload helper is not running.");
+            return false;
+        }
+        if (!sw_atomic_cmp_set(&reload_state->running, 0, 1))
+        {
+            swWarn("a reload is running.");
+            return false;
+        }
+        if (mode == SW_MODE_SINGLE && !only_task_workers)
+        {
+            //the only worker runs in the master, SIGTERM would stop the server
+            if (serv.worker_num == 1)
+            {
+                swWarn("the worker is the master in SW_MODE_SINGLE with one worker, only task workers can be reloaded.");
+                reload_state->running = 0;
+                return false;
+            }
+            swWarn("the connections of a worker are closed with it in SW_MODE_SINGLE.");
+        }
+        reload_state->only_task_workers = only_task_workers;
+        if (kill(helper_pid, SIGUSR1) < 0)
+        {
+            swSysError("kill(%d, SIGUSR1) failed.", helper_pid);
+            reload_state->running = 0;
+            return false;
+        }
+        return true;
+    }
+
+    static void close_inherited_fds(void)
+    {
+        vector<int> fds;
+        DIR *dir = opendir("/proc/self/fd");
+        if (dir == NULL)
+        {
+            return;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            int fd = atoi(entry->d_name);
+            if (fd > STDERR_FILENO && fd != dirfd(dir) && fd != SwooleG.log_fd)
+            {
+                fds.push_back(fd);
+            }
+        }
+        closedir(dir);
+        for (auto iter = fds.begin(); iter != fds.end(); iter++)
+        {
+            ::close(*iter);
+        }
+    }
+
+    /**
+     * libswoole publishes the pid of the master in swServer_start, after the fork of daemonize.
+     * Until then the process that forked the helper stands for the master.
+     */
+    static bool master_alive(pid_t parent_pid, int64_t *orphaned_at)
+    {
+        pid_t master_pid = SwooleGS->master_pid;
+        if (master_pid > 0)
+        {
+            return kill(master_pid, 0) == 0;
+        }
+        if (getppid() == parent_pid)
+        {
+            return true;
+        }
+        //daemonize: the parent has exited, the master it forked publishes its pid in a moment
+        if (*orphaned_at == 0)
+        {
+            *orphaned_at = now_msec();
+        }
+        return now_msec() - *orphaned_at < SW_CPP_RELOAD_HELPER_GRACE * 1000;
+    }
+
+    /**
+     * Forked by start() before libswoole creates any thread, it only needs the shared memory.
+     * reload() wakes it with SIGUSR1, it goes away with the master.
+     */
+    void Server::reloadHelper(pid_t parent_pid)
+    {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR1);
+        sigprocmask(SIG_BLOCK, &set, NULL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        //a daemonized master leaves the terminal, the helper stays in its session
+        signal(SIGHUP, SIG_IGN);
+        close_inherited_fds();
+        reload_state->helper_pid = getpid();
+
+        int64_t orphaned_at = 0;
+        while (master_alive(parent_pid, &orphaned_at))
+        {
+            struct timespec timeout = {1, 0};
+            if (sigtimedwait(&set, NULL, &timeout) != SIGUSR1 || reload_state->running == 0)
+            {
+                continue;
+            }
+            int first = reload_state->only_task_workers ? serv.worker_num : 0;
+            int last = serv.worker_num + SwooleG.task_worker_num;
+            for (int i = first; i < last && SwooleGS->start; i++)
+            {
+                if (!reloadWorker(i))
+                {
+                    break;
+                }
+            }
+            reload_state->running = 0;
+        }
+        _exit(0);
+    }
+
+    bool Server::reloadWorker(int worker_id)
+    {
+        //published by the worker itself once onWorkerStart has returned
+        WorkerCounter *counter = &worker_counters[worker_id];
+        pid_t old_pid = (pid_t) counter->ready_pid;
+        if (old_pid <= 0 || kill(old_pid, 0) < 0)
+        {
+            return true;
+        }
+        if (old_pid == SwooleGS->master_pid)
+        {
+            swWarn("worker #%d runs in the master, reload stopped.", worker_id);
+            return false;
+        }
+
+        //results reaching the new worker would be for tasks it does not know
+        int64_t deadline = now_msec() + reload_timeout * 500;
+        while (counter->pending_tasks > 0 && now_msec() < deadline)
+        {
+            usleep(1000);
+        }
+
+        kill(old_pid, SIGTERM);
+        deadline = now_msec() + reload_timeout * 1000;
+        bool killed = false;
+        //the manager forks the replacement as soon as the worker has exited
+        while (kill(old_pid, 0) == 0)
+        {
+            if (now_msec() >= deadline)
+            {
+                if (killed)
+                {
+                    swWarn("worker #%d(pid=%d) did not exit, reload stopped.", worker_id, old_pid);
+                    return false;
+                }
+                swWarn("worker #%d(pid=%d) did not stop in %d seconds, killed.", worker_id, old_pid, reload_timeout);
+                kill(old_pid, SIGKILL);
+                killed = true;
+                deadline = now_msec() + 5000;
+            }
+            usleep(10000);
+        }
+
+        //capacity comes back before the next worker goes
+        deadline = now_msec() + reload_timeout * 1000;
+        while (counter->ready_pid == old_pid)
+        {
+            if (now_msec() >= deadline || SwooleGS->start == 0)
+            {
+                swWarn("worker #%d was not restarted, reload stopped.", worker_id);
+                return false;
+            }
+            usleep(10000);
+        }
+        return true;
+    }
+
+    /**
+     * With task threads the payload is moved into the task, else it is packed like any DataBuffer.
+     */
+    int Server::task(string &&data, int dst_worker_id)
+    {
+        if (task_pool == NULL)
+        {
+            DataBuffer buffer;
+            buffer.buffer = (void *) data.c_str();
+            buffer.length = data.length();
+            return task(buffer, dst_worker_id);
+        }
+        if (SwooleGS->start == 0)
+        {
+            swWarn("Server is not running.");
+            return -1;
+        }
+        if (check_pool_task_param(dst_worker_id) < 0)
+        {
+            return -1;
+        }
+        if (!admit())
+        {
+            return -1;
+        }
+
+        PoolTask *_task = new PoolTask;
+        _task->server = this;
+        _task->id = task_id++;
+        _task->src_worker_id = SwooleWG.id;
+        _task->data = std::move(data);
+        _task->finished = false;
+        TraceContext *ctx = Tracer::current();
+        _task->traced = ctx != NULL;
+        if (ctx)
+        {
+            _task->trace = *ctx;
+        }
+
+        if (events & EVENT_onFinish)
+        {
+            countWorkerTask(1);
+        }
+        //counted like the tasks of the task workers, so max_tasking covers both
+        sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
+        ThreadPool *pool = task_pool;
+        task_pool->dispatch([_task, pool]()
+        {
+            DataBuffer _data;
+            _data.buffer = (void *) _task->data.c_str();
+            _data.length = _task->data.length();
+
+            //started, the same point where a task worker takes its task off the count
+            sw_atomic_fetch_sub(&SwooleStats->tasking_num, 1);
+            current_pool_task = _task;
+            WorkerCounter *counter = _task->server->getWorkerCounter();
+            if (counter)
+            {
+                sw_atomic_fetch_add(&counter->task_count, 1);
+            }
+            {
+                ArenaScope arena;
+                TraceSpan span("onTask", _task->traced ? &_task->trace : NULL);
+                _task->server->onTask(_task->id, _task->src_worker_id, _data);
+            }
+            current_pool_task = NULL;
+
+            pool->complete([_task]()
+            {
+                Server *_this = _task->server;
+                if (_this->events & EVENT_onFinish)
+                {
+                    _this->countWorkerTask(-1);
+                }
+                if (_task->finished && (_this->events & EVENT_onFinish))
+                {
+                    TraceSpan span("onFinish", _task->traced ? &_task->trace : NULL);
+                    DataBuffer result;
+                    result.buffer = (void *) _task->result.c_str();
+                    result.length = _task->result.length();
+                    _this->onFinish(_task->id, result);
+                }
+                else if (_this->events & EVENT_onFinish)
+                {
+                    _this->onTaskDropped(_task->id);
+                }
+                delete _task;
+            });
+        });
+        return _task->id;
+    }
+
     int Server::task(DataBuffer &data, int dst_worker_id)
     {
         if (SwooleGS->start == 0)
@@ -286,6 +1079,14 @@ namespace swoole
             swWarn("Server is not running.");
             return false;
         }
+        if (task_pool)
+        {
+            return task(string((char *) data.buffer, data.length), dst_worker_id);
+        }
+        if (!admit())
+        {
+            return -1;
+        }
 
         swEventData buf;
         if (check_task_param(dst_worker_id) < 0)
@@ -299,13 +1100,24 @@ namespace swoole
         }
 
         swTask_type(&buf) |= SW_TASK_NONBLOCK;
+        if (events & EVENT_onFinish)
+        {
+            swTask_type(&buf) |= SW_CPP_TASK_ACK;
+        }
+        //counted before the task worker can take it off, the unsigned count never wraps below 0
+        sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
         if (swProcessPool_dispatch(&SwooleGS->task_workers, &buf, &dst_worker_id) >= 0)
         {
-            sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
+            if (events & EVENT_onFinish)
+            {
+                waiting_tasks[buf.info.fd] = time(NULL);
+                countWorkerTask(1);
+            }
             return buf.info.fd;
         }
         else
         {
+            sw_atomic_fetch_sub(&SwooleStats->tasking_num, 1);
             return -1;
         }
     }
@@ -317,6 +1129,24 @@ namespace swoole
             swWarn("Server is not running.");
             return false;
         }
+        if (current_pool_task)
+        {
+            current_pool_task->result.assign((char *) data.buffer, data.length);
+            current_pool_task->finished = true;
+            return true;
+        }
+        //the result goes back with the context of the task
+        TraceContext *ctx = Tracer::current();
+        if (ctx)
+        {
+            string traced;
+            traced.reserve(sizeof(*ctx) + data.length);
+            traced.append((char *) ctx, sizeof(*ctx));
+            traced.append((char *) data.buffer, data.length);
+            task_finished = true;
+            return swTaskWorker_finish(&serv, (char *) traced.c_str(), (int) traced.length(), SW_CPP_TASK_TRACE) == 0;
+        }
+        task_finished = true;
         return swTaskWorker_finish(&serv, (char *) data.buffer, (int) data.length, 0) == 0;
     }
 
@@ -364,6 +1194,15 @@ namespace swoole
     }
 
     bool Server::sendfile(int fd, string &file, off_t offset)
+    {
+        return sendfile(fd, file, offset, 0);
+    }
+
+    /**
+     * length = 0 means to the end of the file, header is sent in front of the body.
+     * A range that stops before EOF is sent from memory, it must fit in buffer_output_size.
+     */
+    bool Server::sendfile(int fd, const string &file, off_t offset, size_t length, const DataBuffer &header)
     {
         if (SwooleGS->start == 0)
         {
@@ -378,18 +1217,131 @@ namespace swoole
             return false;
         }
 
-        struct stat file_stat;
-        if (stat(file.c_str(), &file_stat) < 0)
+        if (offset < 0)
         {
-            swWarn("stat(%s) failed.", file.c_str());
+            swWarn("invalid offset[%ld].", (long) offset);
             return false;
         }
-        if (file_stat.st_size <= offset)
+
+        FileCache::File *cached = file_cache.get(file);
+        if (cached == NULL)
+        {
+            return false;
+        }
+        off_t file_size = cached->info.st_size;
+        if (file_size <= offset)
         {
             swWarn("file[offset=%ld] is empty.", offset);
             return false;
         }
-        return swServer_tcp_sendfile(&serv, fd, (char *) file.c_str(), file.length(), offset) == SW_OK;
+        //offset < file_size here, an unsigned compare also clamps lengths past the range of off_t
+        if (length == 0 || length > (size_t) (file_size - offset))
+        {
+            length = file_size - offset;
+        }
+
+        //up to EOF the reactor sends from the file itself, anything else is read into memory and queued.
+        //libswoole drops what does not fit in the output buffer once the header is out, refuse it up front
+        bool to_eof = offset + (off_t) length == file_size;
+        if (!(to_eof && length > SW_CPP_SENDFILE_CHUNK_SIZE)
+                && header.length + length + pendingBytes(fd) > serv.buffer_output_size)
+        {
+            swoole_error_log(SW_LOG_WARNING, SW_ERROR_OUTPUT_BUFFER_OVERFLOW,
+                             "sendfile(%s) range of %lu bytes does not fit in the output buffer of socket#%d.",
+                             file.c_str(), (unsigned long) length, fd);
+            return false;
+        }
+
+        bool header_sent = false;
+        if (length > SW_CPP_SENDFILE_CHUNK_SIZE)
+        {
+            //the socket lives in this process, zero-copy from the cached descriptor while nothing is queued
+            swConnection *conn = NULL;
+            if (serv.factory_mode == SW_MODE_SINGLE)
+            {
+                conn = swServer_connection_verify_no_ssl(&serv, fd);
+            }
+            if (conn)
+            {
+                if (header.length > 0 && serv.send(&serv, fd, header.buffer, header.length) < 0)
+                {
+                    return false;
+                }
+                header_sent = true;
+                while (length > 0 && (conn->out_buffer == NULL || conn->out_buffer->length == 0))
+                {
+                    ssize_t n = ::sendfile(conn->fd, cached->fd, &offset, length);
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        if (errno == EAGAIN)
+                        {
+                            break;
+                        }
+                        swSysError("sendfile(%s) failed.", file.c_str());
+                        return false;
+                    }
+                    if (n == 0)
+                    {
+                        break;
+                    }
+                    length -= n;
+                }
+                //the socket is full, the reactor sends the rest from the file once it is writable
+                if (length > 0 && to_eof)
+                {
+                    return swServer_tcp_sendfile(&serv, fd, (char *) file.c_str(), file.length(), offset) == SW_OK;
+                }
+                //or the rest of a range is queued in the output buffer below, it was checked to fit
+            }
+            //the reactor thread owns the socket and opens the file itself, it only sends up to EOF
+            else if (to_eof)
+            {
+                if (header.length > 0 && serv.send(&serv, fd, header.buffer, header.length) < 0)
+                {
+                    return false;
+                }
+                return swServer_tcp_sendfile(&serv, fd, (char *) file.c_str(), file.length(), offset) == SW_OK;
+            }
+        }
+
+        //a range, or a small file: read it from the cached descriptor, header and body in one buffer
+        if (sendfile_buffer == NULL)
+        {
+            sendfile_buffer = swString_new(SW_CPP_SENDFILE_CHUNK_SIZE + header.length);
+        }
+        swString_clear(sendfile_buffer);
+        if (header.length > 0 && !header_sent)
+        {
+            swString_append_ptr(sendfile_buffer, (char *) header.buffer, header.length);
+        }
+        while (length > 0)
+        {
+            size_t n = length > SW_CPP_SENDFILE_CHUNK_SIZE ? SW_CPP_SENDFILE_CHUNK_SIZE : length;
+            if (sendfile_buffer->size < sendfile_buffer->length + n && swString_extend(sendfile_buffer,
+                                                                                       sendfile_buffer->length + n) < 0)
+            {
+                return false;
+            }
+            ssize_t ret = pread(cached->fd, sendfile_buffer->str + sendfile_buffer->length, n, offset);
+            if (ret <= 0)
+            {
+                swSysError("pread(%s) failed.", file.c_str());
+                return false;
+            }
+            sendfile_buffer->length += ret;
+            if (serv.send(&serv, fd, sendfile_buffer->str, sendfile_buffer->length) < 0)
+            {
+                return false;
+            }
+            swString_clear(sendfile_buffer);
+            offset += ret;
+            length -= ret;
+        }
+        return true;
     }
 
     bool Server::sendMessage(int worker_id, DataBuffer &data)
@@ -420,6 +1372,14 @@ namespace swoole
             return false;
         }
 
+        //event workers are reachable through the shared memory channel, no syscall if the consumer is busy.
+        //traced messages take the pipe, the channel has no room for the context
+        if (worker_id < (int) channels.size() && Tracer::current() == NULL
+                && channels[worker_id]->push(SwooleWG.id, data.buffer, data.length))
+        {
+            return true;
+        }
+
         if (task_pack(&buf, data) < 0)
         {
             return false;
@@ -433,6 +1393,60 @@ namespace swoole
                                     SW_PIPE_MASTER | SW_PIPE_NONBLOCK) == SW_OK;
     }
 
+    void Server::setCompression(int level, size_t min_length)
+    {
+        compress_level = level;
+        compress_min_length = min_length;
+    }
+
+    bool Server::sendCompressed(int fd, const DataBuffer &data, CompressEncoding encoding)
+    {
+        CompressStream stream([this, fd](const char *chunk, size_t length)
+        {
+            return this->send(fd, chunk, (int) length);
+        }, compress_level, encoding);
+        return stream.write(data.buffer, data.length) && stream.end();
+    }
+
+    void Server::setMessageChannel(size_t capacity, size_t slot_size)
+    {
+        channel_capacity = capacity;
+        channel_slot_size = slot_size;
+    }
+
+    int Server::_onChannelRead(swReactor *reactor, swEvent *event)
+    {
+        Server *_this = (Server *) SwooleG.serv->ptr2;
+        Channel *channel = _this->channels[SwooleWG.id];
+        channel->clearNotify();
+
+        int src_worker_id;
+        DataBuffer data;
+        char *buffer;
+
+        for (int i = 0; ; i++)
+        {
+            //yield to the reactor, the rest is read in the next round
+            if (i == SW_CPP_CHANNEL_BATCH_NUM)
+            {
+                channel->notify();
+                break;
+            }
+            if (!channel->peek(&src_worker_id, &buffer, &data.length))
+            {
+                if (channel->sleep())
+                {
+                    break;
+                }
+                continue;
+            }
+            data.buffer = buffer;
+            _this->onPipeMessage(src_worker_id, data);
+            channel->pop();
+        }
+        return SW_OK;
+    }
+
     bool Server::sendwait(int fd, const DataBuffer &data)
     {
         if (SwooleGS->start == 0)
@@ -466,38 +1480,46 @@ namespace swoole
     bool Server::start(void)
     {
         serv.ptr2 = this;
-        if (this->events & EVENT_onStart)
+        if ((this->events & EVENT_onStart) || logger)
         {
             serv.onStart = Server::_onStart;
         }
-        if (this->events & EVENT_onShutdown)
+        if ((this->events & EVENT_onShutdown) || logger)
         {
             serv.onShutdown = Server::_onShutdown;
         }
-        if (this->events & EVENT_onConnect)
+        //one lookup by the listening socket finds the handler of a port
+        for (auto iter = listen_ports.begin(); iter != listen_ports.end(); iter++)
+        {
+            if ((*iter)->getHandler() == NULL)
+            {
+                continue;
+            }
+            int sock = (*iter)->getSocket();
+            if ((size_t) sock >= handlers.size())
+            {
+                handlers.resize(sock + 1, NULL);
+            }
+            handlers[sock] = (*iter)->getHandler();
+        }
+        if ((this->events & EVENT_onConnect) || contexts || !handlers.empty() || idle_timeout > 0)
         {
             serv.onConnect = Server::_onConnect;
         }
-        if (this->events & EVENT_onReceive)
+        if ((this->events & EVENT_onReceive) || !handlers.empty() || idle_timeout > 0)
         {
             serv.onReceive = Server::_onReceive;
         }
-        if (this->events & EVENT_onPacket)
+        if ((this->events & EVENT_onPacket) || !handlers.empty())
         {
             serv.onPacket = Server::_onPacket;
         }
-        if (this->events & EVENT_onClose)
+        if ((this->events & EVENT_onClose) || contexts || !handlers.empty() || idle_timeout > 0)
         {
             serv.onClose = Server::_onClose;
         }
-        if (this->events & EVENT_onWorkerStart)
-        {
-            serv.onWorkerStart = Server::_onWorkerStart;
-        }
-        if (this->events & EVENT_onWorkerStop)
-        {
-            serv.onWorkerStop = Server::_onWorkerStop;
-        }
+        serv.onWorkerStart = Server::_onWorkerStart;
+        serv.onWorkerStop = Server::_onWorkerStop;
         if (this->events & EVENT_onTask)
         {
             serv.onTask = Server::_onTask;
@@ -510,6 +1532,110 @@ namespace swoole
         {
             serv.onPipeMessage = Server::_onPipeMessage;
         }
+        if (this->events & EVENT_onBufferFull)
+        {
+            serv.onBufferFull = Server::_onBufferFull;
+        }
+        if (this->events & EVENT_onBufferEmpty)
+        {
+            serv.onBufferEmpty = Server::_onBufferEmpty;
+        }
+        if (buffer_high_watermark > 0)
+        {
+            for (auto iter = ports.begin(); iter != ports.end(); iter++)
+            {
+                (*iter)->buffer_high_watermark = (uint32_t) buffer_high_watermark;
+                (*iter)->buffer_low_watermark = (uint32_t) buffer_low_watermark;
+            }
+        }
+        //the channels must be in shared memory before the workers are forked
+        if (channel_capacity > 0 && (this->events & EVENT_onPipeMessage))
+        {
+            for (int i = 0; i < serv.worker_num; i++)
+            {
+                Channel *channel = new Channel(channel_capacity, channel_slot_size);
+                //the consumer is the only reader, keep the ring on its node
+                int node = affinity.getNode(Affinity::ROLE_WORKER, i);
+                if (node >= 0 && Affinity::getNodeNum() > 1)
+                {
+                    channel->bindNode(node);
+                }
+                channels.push_back(channel);
+            }
+        }
+        if (logger && !logger->create(serv.worker_num + SwooleG.task_worker_num))
+        {
+            return false;
+        }
+        if (rate_limiter)
+        {
+            if (!rate_limiter->create(serv.max_connection))
+            {
+                return false;
+            }
+            //before swServer_start, no reactor thread or worker exists yet
+            dispatch_rate_limiter = rate_limiter;
+            factory_dispatch = serv.factory.dispatch;
+            serv.factory.dispatch = rate_limit_dispatch;
+        }
+        reload_state = (ReloadState *) sw_shm_calloc(1, sizeof(ReloadState));
+        if (reload_state == NULL)
+        {
+            swWarn("sw_shm_calloc(%ld) failed.", sizeof(ReloadState));
+            return false;
+        }
+        size_t counter_num = serv.worker_num + SwooleG.task_worker_num;
+        worker_counters = (WorkerCounter *) sw_shm_calloc(counter_num, sizeof(WorkerCounter));
+        if (worker_counters == NULL)
+        {
+            swWarn("sw_shm_calloc(%ld) failed.", counter_num * sizeof(WorkerCounter));
+            return false;
+        }
+        //reactor threads are pinned by libswoole
+        const vector<int> &reactor_cpus = affinity.get(Affinity::ROLE_REACTOR);
+        if (!reactor_cpus.empty())
+        {
+            serv.open_cpu_affinity = 1;
+            serv.cpu_affinity_available_num = (uint16_t) reactor_cpus.size();
+            serv.cpu_affinity_available = (uint16_t *) sw_malloc(sizeof(uint16_t) * reactor_cpus.size());
+            for (size_t i = 0; i < reactor_cpus.size(); i++)
+            {
+                serv.cpu_affinity_available[i] = (uint16_t) reactor_cpus[i];
+            }
+        }
+        if (reuse_port)
+        {
+            if (mode != SW_MODE_SINGLE)
+            {
+                swWarn("reuse port can only be used in SW_MODE_SINGLE.");
+                reuse_port = false;
+            }
+            //the shared listener must join the SO_REUSEPORT group as well, rebind it before listen()
+            for (auto iter = ports.begin(); reuse_port && iter != ports.end(); iter++)
+            {
+                int sock = reuseport_socket(*iter, false, 0);
+                if (sock < 0)
+                {
+                    continue;
+                }
+                dup2(sock, (*iter)->sock);
+                ::close(sock);
+            }
+        }
+        //the process has no threads yet, the helper is a plain copy of it
+        pid_t parent_pid = getpid();
+        pid_t helper_pid = fork();
+        if (helper_pid < 0)
+        {
+            swSysError("fork() failed.");
+            return false;
+        }
+        if (helper_pid == 0)
+        {
+            reloadHelper(parent_pid);
+        }
+        reload_state->helper_pid = helper_pid;
+
         _callback_buffer = swString_new(8192);
         int ret = swServer_start(&serv);
         if (ret < 0)
@@ -524,20 +1650,178 @@ namespace swoole
     {
         DataBuffer data = get_recv_data(req, NULL, 0);
         Server *_this = (Server *) serv->ptr2;
-        _this->onReceive(req->info.fd, data);
+        if (_this->idle_wheel)
+        {
+            _this->idle_wheel->touch(_this->getConnectionIndex(req->info.fd));
+        }
+        WorkerCounter *counter = _this->getWorkerCounter();
+        if (counter)
+        {
+            sw_atomic_fetch_add(&counter->request_count, 1);
+        }
+        ArenaScope arena;
+        TraceSpan span("onReceive", TraceSpan::ROOT);
+        PortHandler *handler = _this->getHandler(req->info.from_fd);
+        if (handler)
+        {
+            handler->onReceive(req->info.fd, data);
+        }
+        else if (_this->events & EVENT_onReceive)
+        {
+            _this->onReceive(req->info.fd, data);
+        }
         return SW_OK;
     }
 
     void Server::_onWorkerStart(swServer *serv, int worker_id)
     {
         Server *_this = (Server *) serv->ptr2;
-        _this->onWorkerStart(worker_id);
+        //pin before anything is allocated, so the memory of the worker is local to its node
+        Affinity::Role role = swIsTaskWorker() ? Affinity::ROLE_TASK_WORKER : Affinity::ROLE_WORKER;
+        int cpu = _this->affinity.getCpu(role, swIsTaskWorker() ? worker_id - serv->worker_num : worker_id);
+        if (cpu >= 0 && Affinity::bindCpu(cpu) && Affinity::getNodeNum() > 1)
+        {
+            Affinity::bindProcessMemory(Affinity::getCpuNode(cpu));
+        }
+        if (_this->task_thread_num > 0 && !swIsTaskWorker())
+        {
+            _this->task_pool = new ThreadPool(_this->task_thread_num);
+            _this->task_pool->attach(SwooleG.main_reactor);
+        }
+        if (_this->idle_timeout > 0 && !swIsTaskWorker())
+        {
+            _this->idle_wheel = new IdleWheel(_this->idle_timeout, [_this](int session_id)
+            {
+                _this->close(session_id, false);
+            });
+        }
+        if (_this->reuse_port && !swIsTaskWorker())
+        {
+            reuseport_worker_listen(serv, _this->ports);
+        }
+        if (worker_id < (int) _this->channels.size())
+        {
+            swReactor *reactor = SwooleG.main_reactor;
+            reactor->setHandle(reactor, FD_CHANNEL | SW_EVENT_READ, Server::_onChannelRead);
+            reactor->add(reactor, _this->channels[worker_id]->getFd(), FD_CHANNEL | SW_EVENT_READ);
+            //a restarted worker drains what its predecessor left behind
+            _this->channels[worker_id]->notify();
+        }
+#ifndef SW_USE_RINGBUFFER
+        //take over the pipe from the master before the first package arrives
+        if ((_this->events & EVENT_onReceiveChunk) && !swIsTaskWorker())
+        {
+            SwooleG.main_reactor->setHandle(SwooleG.main_reactor, SW_FD_PIPE | SW_EVENT_READ, Server::_onPipeRead);
+        }
+#endif
+        if (_this->events & EVENT_onWorkerStart)
+        {
+            _this->onWorkerStart(worker_id);
+        }
+        //reload() moves on to the next worker once this one is up
+        WorkerCounter *counter = _this->getWorkerCounter();
+        if (counter)
+        {
+            counter->ready_pid = getpid();
+        }
+    }
+
+    /**
+     * Pieces of a large package go straight to onReceiveChunk from the pipe packet,
+     * nothing is collected in the worker buffer. Everything else takes the usual way.
+     */
+    int Server::_onPipeRead(swReactor *reactor, swEvent *event)
+    {
+        swEventData task;
+        Server *_this = (Server *) SwooleG.serv->ptr2;
+
+        while (read(event->fd, &task, sizeof(task)) > 0)
+        {
+            int type = task.info.type;
+            //a port with its own handler gets whole messages, swWorker_onTask buffers them
+            if ((type == SW_EVENT_PACKAGE_START || type == SW_EVENT_PACKAGE_END)
+                    && _this->getHandler(task.info.from_fd) == NULL)
+            {
+                _this->receiveChunk(&task);
+            }
+            else
+            {
+                swWorker_onTask(&SwooleG.serv->factory, &task);
+            }
+            //the rest of the package follows right behind
+            if (type != SW_EVENT_PACKAGE_START)
+            {
+                break;
+            }
+        }
+        return SW_OK;
+    }
+
+    /**
+     * The bookkeeping of swWorker_onTask for a piece of a large package.
+     */
+    void Server::receiveChunk(swEventData *task)
+    {
+        //the connection was closed, the fd may already belong to a new one
+        swConnection *conn = swServer_connection_verify(&serv, task->info.fd);
+        if (conn == NULL || conn->closed)
+        {
+            swoole_error_log(SW_LOG_NOTICE, SW_ERROR_SESSION_DISCARD_DATA,
+                             "received the wrong data[%d bytes] from socket#%d", task->info.len, task->info.fd);
+            return;
+        }
+
+        swWorker *worker = swServer_get_worker(&serv, (uint16_t) SwooleWG.id);
+        worker->status = SW_WORKER_BUSY;
+
+        bool last = task->info.type == SW_EVENT_PACKAGE_END;
+        if (last)
+        {
+            SwooleWG.request_count++;
+            sw_atomic_fetch_add(&SwooleStats->request_count, 1);
+            WorkerCounter *counter = getWorkerCounter();
+            if (counter)
+            {
+                sw_atomic_fetch_add(&counter->request_count, 1);
+            }
+        }
+        if (idle_wheel)
+        {
+            idle_wheel->touch(getConnectionIndex(task->info.fd));
+        }
+        {
+            ArenaScope arena;
+            TraceSpan span("onReceiveChunk", TraceSpan::ROOT);
+            DataBuffer chunk;
+            chunk.copy(task->data, task->info.len);
+            onReceiveChunk(task->info.fd, chunk, last);
+        }
+
+        worker->status = SW_WORKER_IDLE;
+        if (!SwooleWG.run_always && SwooleWG.request_count >= SwooleWG.max_request)
+        {
+            swWorker_stop();
+        }
     }
 
     void Server::_onWorkerStop(swServer *serv, int worker_id)
     {
         Server *_this = (Server *) serv->ptr2;
-        _this->onWorkerStop(worker_id);
+        //the work in flight completes before the worker goes, onFinish included
+        if (_this->task_pool)
+        {
+            _this->task_pool->wait();
+        }
+        AsyncIO::wait();
+        if (_this->events & EVENT_onWorkerStop)
+        {
+            _this->onWorkerStop(worker_id);
+        }
+        delete _this->task_pool;
+        _this->task_pool = NULL;
+        delete _this->idle_wheel;
+        _this->idle_wheel = NULL;
+        Tracer::flush();
     }
 
     int Server::_onPacket(swServer *serv, swEventData *req)
@@ -580,7 +1864,22 @@ namespace swoole
         _data.copy(data, length);
 
         Server *_this = (Server *) serv->ptr2;
-        _this->onPacket(_data, clientInfo);
+        WorkerCounter *counter = _this->getWorkerCounter();
+        if (counter)
+        {
+            sw_atomic_fetch_add(&counter->request_count, 1);
+        }
+        ArenaScope arena;
+        TraceSpan span("onPacket", TraceSpan::ROOT);
+        PortHandler *handler = _this->getHandler(clientInfo.server_socket);
+        if (handler)
+        {
+            handler->onPacket(_data, clientInfo);
+        }
+        else if (_this->events & EVENT_onPacket)
+        {
+            _this->onPacket(_data, clientInfo);
+        }
 
         return SW_OK;
     }
@@ -588,46 +1887,140 @@ namespace swoole
     void Server::_onStart(swServer *serv)
     {
         Server *_this = (Server *) serv->ptr2;
-        _this->onStart();
+        if (_this->logger)
+        {
+            _this->logger->start();
+        }
+        if (_this->events & EVENT_onStart)
+        {
+            _this->onStart();
+        }
     }
 
     void Server::_onShutdown(swServer *serv)
     {
         Server *_this = (Server *) serv->ptr2;
-        _this->onShutdown();
+        if (_this->events & EVENT_onShutdown)
+        {
+            _this->onShutdown();
+        }
+        //drain what the workers left behind
+        if (_this->logger)
+        {
+            _this->logger->stop();
+        }
     }
 
     void Server::_onConnect(swServer *serv, swDataHead *info)
     {
         Server *_this = (Server *) serv->ptr2;
-        _this->onConnect(info->fd);
+        if (_this->contexts)
+        {
+            _this->contexts->create(_this->getConnectionIndex(info->fd), info->fd);
+        }
+        if (_this->idle_wheel)
+        {
+            _this->idle_wheel->add(_this->getConnectionIndex(info->fd), info->fd);
+        }
+        PortHandler *handler = _this->getHandler(info->from_fd);
+        if (handler)
+        {
+            handler->onConnect(info->fd);
+        }
+        else if (_this->events & EVENT_onConnect)
+        {
+            _this->onConnect(info->fd);
+        }
     }
 
     void Server::_onClose(swServer *serv, swDataHead *info)
     {
         Server *_this = (Server *) serv->ptr2;
-        _this->onClose(info->fd);
+        PortHandler *handler = _this->getHandler(info->from_fd);
+        if (handler)
+        {
+            handler->onClose(info->fd);
+        }
+        else if (_this->events & EVENT_onClose)
+        {
+            _this->onClose(info->fd);
+        }
+        if (_this->contexts)
+        {
+            _this->contexts->destroy(_this->getConnectionIndex(info->fd), info->fd);
+        }
+        if (_this->idle_wheel)
+        {
+            _this->idle_wheel->remove(_this->getConnectionIndex(info->fd));
+        }
+    }
+
+    void Server::_onBufferFull(swServer *serv, swDataHead *info)
+    {
+        Server *_this = (Server *) serv->ptr2;
+        _this->onBufferFull(info->fd);
+    }
+
+    void Server::_onBufferEmpty(swServer *serv, swDataHead *info)
+    {
+        Server *_this = (Server *) serv->ptr2;
+        _this->onBufferEmpty(info->fd);
     }
 
     void Server::_onPipeMessage(swServer *serv, swEventData *req)
     {
         DataBuffer data = task_unpack(req);
         Server *_this = (Server *) serv->ptr2;
+        TraceContext ctx;
+        TraceSpan span("onPipeMessage", trace_unpack(req, data, &ctx));
         _this->onPipeMessage(req->info.from_id, data);
     }
 
     int Server::_onTask(swServer *serv, swEventData *task)
     {
         Server *_this = (Server *) serv->ptr2;
+        //raised by task(), taskwait() and taskWaitMulti() when they dispatched it
+        sw_atomic_fetch_sub(&SwooleStats->tasking_num, 1);
         DataBuffer data = task_unpack(task);
+        WorkerCounter *counter = _this->getWorkerCounter();
+        if (counter)
+        {
+            sw_atomic_fetch_add(&counter->task_count, 1);
+        }
+        ArenaScope arena;
+        TraceContext ctx;
+        TraceSpan span("onTask", trace_unpack(task, data, &ctx));
+        bool ack = swTask_type(task) & SW_CPP_TASK_ACK;
+        task_finished = false;
         _this->onTask(task->info.fd, task->info.from_fd, data);
+        //the worker stops counting the task without a result
+        if (ack && !task_finished)
+        {
+            swTaskWorker_finish(serv, (char *) "", 0, SW_CPP_TASK_ACK);
+        }
         return SW_OK;
     }
 
     int Server::_onFinish(swServer *serv, swEventData *task)
     {
         Server *_this = (Server *) serv->ptr2;
+        bool waiting = _this->waiting_tasks.erase(task->info.fd) > 0;
+        if (waiting)
+        {
+            _this->countWorkerTask(-1);
+        }
+        if (swTask_type(task) & SW_CPP_TASK_ACK)
+        {
+            //dropped already if it expired
+            if (waiting)
+            {
+                _this->onTaskDropped(task->info.fd);
+            }
+            return SW_OK;
+        }
         DataBuffer data = task_unpack(task);
+        TraceContext ctx;
+        TraceSpan span("onFinish", trace_unpack(task, data, &ctx));
         _this->onFinish(task->info.fd, data);
         return SW_OK;
     }
@@ -647,7 +2040,12 @@ namespace swoole
         {
             return retval;
         }
+        if (!admit())
+        {
+            return retval;
+        }
 
+        TraceSpan span("taskwait");
         task_pack(&buf, data);
 
         uint64_t notify;
@@ -659,14 +2057,21 @@ namespace swoole
         //clear history task
         while (read(efd, &notify, sizeof(notify)) > 0);
 
-        if (swProcessPool_dispatch_blocking(&SwooleGS->task_workers, &buf, &dst_worker_id) >= 0)
+        sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
+        if (swProcessPool_dispatch_blocking(&SwooleGS->task_workers, &buf, &dst_worker_id) < 0)
+        {
+            sw_atomic_fetch_sub(&SwooleStats->tasking_num, 1);
+        }
+        else
         {
-            sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
             task_notify_pipe->timeout = timeout;
             int ret = task_notify_pipe->read(task_notify_pipe, &notify, sizeof(notify));
             if (ret > 0)
             {
-                return task_unpack(task_result);
+                TraceContext ctx;
+                retval = task_unpack(task_result);
+                trace_unpack(task_result, retval, &ctx);
+                return retval;
             }
             else
             {
@@ -686,6 +2091,10 @@ namespace swoole
             swWarn("server is not running.");
             return retval;
         }
+        if (!admit())
+        {
+            return retval;
+        }
 
         int dst_worker_id;
         int task_id;
@@ -694,6 +2103,8 @@ namespace swoole
 
         int list_of_id[1024];
 
+        TraceSpan span("taskWaitMulti");
+
         uint64_t notify;
         swEventData *task_result = &(SwooleG.task_result[SwooleWG.id]);
         bzero(task_result, sizeof(swEventData));
@@ -730,13 +2141,14 @@ namespace swoole
             }
             swTask_type(&buf) |= SW_TASK_WAITALL;
             dst_worker_id = -1;
+            sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
             if (swProcessPool_dispatch_blocking(&SwooleGS->task_workers, &buf, &dst_worker_id) >= 0)
             {
-                sw_atomic_fetch_add(&SwooleStats->tasking_num, 1);
                 list_of_id[i] = task_id;
             }
             else
             {
+                sw_atomic_fetch_sub(&SwooleStats->tasking_num, 1);
                 swWarn("taskwait failed. Error: %s[%d]", strerror(errno), errno);
                 fail:
                     retval[i] = DataBuffer();
@@ -772,6 +2184,7 @@ namespace swoole
 
         swEventData *result;
         DataBuffer zdata;
+        TraceContext ctx;
         int j;
 
         for (i = 0; i < n_task; i++)
@@ -779,6 +2192,7 @@ namespace swoole
             result = (swEventData *) (content->str + content->offset);
             task_id = result->info.fd;
             zdata = task_unpack(result);
+            trace_unpack(result, zdata, &ctx);
             for (j = 0; j < n_task; j++)
             {
                 if (list_of_id[j] == task_id)
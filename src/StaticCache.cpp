@@ -0,0 +1,257 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "StaticCache.hpp"
+
+namespace swoole
+{
+    static const char *mime_types[][2] = {
+        {"html", "text/html"},
+        {"htm", "text/html"},
+        {"css", "text/css"},
+        {"js", "application/javascript"},
+        {"json", "application/json"},
+        {"txt", "text/plain"},
+        {"xml", "text/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"ico", "image/x-icon"},
+        {"webp", "image/webp"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+    };
+
+    static const char *get_mime_type(const string &path)
+    {
+        size_t dot = path.rfind('.');
+        if (dot != string::npos)
+        {
+            const char *ext = path.c_str() + dot + 1;
+            for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++)
+            {
+                if (strcasecmp(ext, mime_types[i][0]) == 0)
+                {
+                    return mime_types[i][1];
+                }
+            }
+        }
+        return "application/octet-stream";
+    }
+
+    /**
+     * A missing file reads as a zeroed stat, so it compares equal to another missing file.
+     */
+    static bool stat_file(const string &file, struct stat *info)
+    {
+        if (stat(file.c_str(), info) < 0 || !S_ISREG(info->st_mode))
+        {
+            memset(info, 0, sizeof(*info));
+            return false;
+        }
+        return true;
+    }
+
+    static bool same_file(const struct stat &a, const struct stat &b)
+    {
+        return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_mtime == b.st_mtime && a.st_size == b.st_size;
+    }
+
+    StaticCache::StaticCache(size_t _memory_limit, size_t _max_file_size)
+    {
+        memory_limit = _memory_limit;
+        max_file_size = _max_file_size;
+        memory_usage = 0;
+    }
+
+    StaticCache::~StaticCache()
+    {
+        clear();
+    }
+
+    string StaticCache::buildHeader(const string &path, const struct stat &info, size_t length, bool gzip)
+    {
+        char date[64];
+        struct tm tm;
+        gmtime_r(&info.st_mtime, &tm);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+        char header[512];
+        int n = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\n"
+                "Content-Type: %s\r\n"
+                "Content-Length: %ld\r\n"
+                "Last-Modified: %s\r\n"
+                "%s"
+                "\r\n", get_mime_type(path), (long) length, date,
+                         gzip ? "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n" : "");
+        return string(header, n);
+    }
+
+    bool StaticCache::loadResponse(Response *response, const string &header, const string &file, size_t length)
+    {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            swSysError("open(%s) failed.", file.c_str());
+            return false;
+        }
+        response->length = header.length() + length;
+        response->data = (char *) sw_malloc(response->length);
+        if (response->data == NULL)
+        {
+            ::close(fd);
+            return false;
+        }
+        memcpy(response->data, header.c_str(), header.length());
+        int ret = swoole_sync_readfile(fd, response->data + header.length(), (int) length);
+        ::close(fd);
+        if (ret != (int) length)
+        {
+            sw_free(response->data);
+            response->data = NULL;
+            response->length = 0;
+            return false;
+        }
+        memory_usage += response->length;
+        return true;
+    }
+
+    bool StaticCache::load(Entry *entry)
+    {
+        if (stat(entry->path.c_str(), &entry->info) < 0 || !S_ISREG(entry->info.st_mode)
+            || (size_t) entry->info.st_size > max_file_size)
+        {
+            return false;
+        }
+        string header = buildHeader(entry->path, entry->info, entry->info.st_size, false);
+        if (!loadResponse(&entry->plain, header, entry->path, entry->info.st_size))
+        {
+            return false;
+        }
+
+        string gzip_file = entry->path + ".gz";
+        if (stat_file(gzip_file, &entry->gzip_info) && (size_t) entry->gzip_info.st_size <= max_file_size)
+        {
+            header = buildHeader(entry->path, entry->info, entry->gzip_info.st_size, true);
+            loadResponse(&entry->gzip, header, gzip_file, entry->gzip_info.st_size);
+        }
+        entry->expire = time(NULL) + SW_CPP_FILE_CACHE_TTL;
+        return true;
+    }
+
+    void StaticCache::release(Entry *entry)
+    {
+        if (entry->plain.data)
+        {
+            memory_usage -= entry->plain.length;
+            sw_free(entry->plain.data);
+            entry->plain = Response();
+        }
+        if (entry->gzip.data)
+        {
+            memory_usage -= entry->gzip.length;
+            sw_free(entry->gzip.data);
+            entry->gzip = Response();
+        }
+    }
+
+    const StaticCache::Entry *StaticCache::get(const string &path)
+    {
+        auto iter = index.find(path);
+        if (iter != index.end())
+        {
+            Entry *entry = &(*iter->second);
+            lru.splice(lru.begin(), lru, iter->second);
+
+            time_t now = time(NULL);
+            if (entry->expire > now)
+            {
+                return entry;
+            }
+            //the .gz sibling may have been added, removed or replaced on its own
+            struct stat info, gzip_info;
+            stat_file(path + ".gz", &gzip_info);
+            if (stat(path.c_str(), &info) == 0 && same_file(info, entry->info) && same_file(gzip_info, entry->gzip_info))
+            {
+                entry->expire = now + SW_CPP_FILE_CACHE_TTL;
+                return entry;
+            }
+            //the file was modified, build it again
+            release(entry);
+            if (load(entry))
+            {
+                return entry;
+            }
+            index.erase(iter);
+            lru.pop_front();
+            return NULL;
+        }
+
+        Entry entry;
+        entry.path = path;
+        if (!load(&entry))
+        {
+            release(&entry);
+            return NULL;
+        }
+        lru.push_front(entry);
+        index[path] = lru.begin();
+
+        //evict the least recently used entries to stay in the memory budget
+        while (memory_usage > memory_limit && lru.size() > 1)
+        {
+            Entry &last = lru.back();
+            release(&last);
+            index.erase(last.path);
+            lru.pop_back();
+        }
+        return &lru.front();
+    }
+
+    bool StaticCache::send(Server &server, int fd, const string &path, bool accept_gzip)
+    {
+        const Entry *entry = get(path);
+        if (entry)
+        {
+            const Response &response = (accept_gzip && entry->gzip.data) ? entry->gzip : entry->plain;
+            return server.send(fd, response.data, (int) response.length);
+        }
+
+        struct stat info;
+        if (stat(path.c_str(), &info) < 0 || !S_ISREG(info.st_mode))
+        {
+            return false;
+        }
+        string header = buildHeader(path, info, info.st_size, false);
+        //point at the string, the copying constructors would overwrite the data of onReceive
+        DataBuffer buffer;
+        buffer.buffer = (void *) header.c_str();
+        buffer.length = header.length();
+        return server.sendfile(fd, path, 0, 0, buffer);
+    }
+
+    void StaticCache::clear(void)
+    {
+        for (auto iter = lru.begin(); iter != lru.end(); iter++)
+        {
+            release(&(*iter));
+        }
+        lru.clear();
+        index.clear();
+    }
+}
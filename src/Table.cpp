@@ -0,0 +1,451 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Table.hpp"
+
+namespace swoole
+{
+    static bool read_int(swTableRow *row, swTableColumn *col, long &value)
+    {
+        char *ptr = row->data + col->index;
+        switch (col->type)
+        {
+        case SW_TABLE_INT8:
+            value = *(int8_t *) ptr;
+            break;
+        case SW_TABLE_INT16:
+            value = *(int16_t *) ptr;
+            break;
+        case SW_TABLE_INT32:
+            value = *(int32_t *) ptr;
+            break;
+        case SW_TABLE_INT64:
+            value = *(int64_t *) ptr;
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    static bool read_float(swTableRow *row, swTableColumn *col, double &value)
+    {
+        if (col->type != SW_TABLE_FLOAT)
+        {
+            return false;
+        }
+        memcpy(&value, row->data + col->index, sizeof(value));
+        return true;
+    }
+
+    static bool read_string(swTableRow *row, swTableColumn *col, string &value)
+    {
+        if (col->type != SW_TABLE_STRING)
+        {
+            return false;
+        }
+        swTable_string_length_t vlen;
+        memcpy(&vlen, row->data + col->index, sizeof(vlen));
+        value.assign(row->data + col->index + sizeof(vlen), vlen);
+        return true;
+    }
+
+    static swTableColumn *get_column(swTable *table, const string &column)
+    {
+        return swTableColumn_get(table, (char *) column.c_str(), (int) column.length());
+    }
+
+    static bool is_int_column(swTableColumn *col)
+    {
+        return col->type == SW_TABLE_INT8 || col->type == SW_TABLE_INT16 || col->type == SW_TABLE_INT32
+                || col->type == SW_TABLE_INT64;
+    }
+
+    /**
+     * INT8/16/32 columns would keep only the low bytes of a value out of their range.
+     */
+    static bool int_fits(swTableColumn *col, int64_t value)
+    {
+        switch (col->type)
+        {
+        case SW_TABLE_INT8:
+            return value >= INT8_MIN && value <= INT8_MAX;
+        case SW_TABLE_INT16:
+            return value >= INT16_MIN && value <= INT16_MAX;
+        case SW_TABLE_INT32:
+            return value >= INT32_MIN && value <= INT32_MAX;
+        default:
+            return true;
+        }
+    }
+
+    static bool check_int(swTableColumn *col, const string &column, int64_t value)
+    {
+        if (!int_fits(col, value))
+        {
+            swWarn("value[%ld] is out of the range of column[%s].", (long) value, column.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * The column a value of type and length may be written to, NULL if there is none.
+     */
+    static swTableColumn *get_value_column(swTable *table, const string &column, Table::ColumnType type, int length)
+    {
+        swTableColumn *col = get_column(table, column);
+        if (col == NULL)
+        {
+            swWarn("column[%s] does not exist.", column.c_str());
+            return NULL;
+        }
+        //the same checks as the getters, a value never lands in a column of another type
+        bool matched = type == Table::TYPE_INT ? is_int_column(col) : (int) col->type == type;
+        if (!matched)
+        {
+            swWarn("column[%s] is of another type.", column.c_str());
+            return NULL;
+        }
+        if (type == Table::TYPE_STRING && (size_t) length > col->size - sizeof(swTable_string_length_t))
+        {
+            swWarn("value of column[%s] is too long.", column.c_str());
+            return NULL;
+        }
+        return col;
+    }
+
+    bool TableRow::get(const string &column, long &value)
+    {
+        swTableColumn *col = get_column(table, column);
+        return col && read_int(row, col, value);
+    }
+
+    bool TableRow::get(const string &column, double &value)
+    {
+        swTableColumn *col = get_column(table, column);
+        return col && read_float(row, col, value);
+    }
+
+    bool TableRow::get(const string &column, string &value)
+    {
+        swTableColumn *col = get_column(table, column);
+        return col && read_string(row, col, value);
+    }
+
+    bool TableRow::set(const string &column, long value)
+    {
+        int64_t _value = value;
+        swTableColumn *col = get_value_column(table, column, Table::TYPE_INT, 0);
+        if (col == NULL || !check_int(col, column, _value))
+        {
+            return false;
+        }
+        swTableRow_set_value(row, col, &_value, 0);
+        return true;
+    }
+
+    bool TableRow::set(const string &column, double value)
+    {
+        swTableColumn *col = get_value_column(table, column, Table::TYPE_FLOAT, 0);
+        if (col)
+        {
+            swTableRow_set_value(row, col, &value, 0);
+        }
+        return col != NULL;
+    }
+
+    bool TableRow::set(const string &column, const string &value)
+    {
+        swTableColumn *col = get_value_column(table, column, Table::TYPE_STRING, (int) value.length());
+        if (col)
+        {
+            swTableRow_set_value(row, col, (void *) value.c_str(), (int) value.length());
+        }
+        return col != NULL;
+    }
+
+    Table::Table(size_t rows)
+    {
+        created = false;
+        table = swTable_new((uint32_t) rows);
+        if (table == NULL)
+        {
+            swWarn("alloc table failed.");
+            abort();
+        }
+    }
+
+    Table::~Table()
+    {
+        //the memory is shared with the other processes, only the master may release it
+        if (SwooleGS == NULL || SwooleGS->start == 0 || swIsMaster())
+        {
+            swTable_free(table);
+        }
+    }
+
+    bool Table::column(const string &name, ColumnType type, size_t size)
+    {
+        if (created)
+        {
+            swWarn("cannot add column after the table is created.");
+            return false;
+        }
+        if (type == TYPE_STRING && size == 0)
+        {
+            swWarn("the length of string column must be greater than 0.");
+            return false;
+        }
+        if (type == TYPE_INT && size == 0)
+        {
+            size = sizeof(long);
+        }
+        return swTableColumn_add(table, (char *) name.c_str(), (int) name.length(), type, (int) size) == SW_OK;
+    }
+
+    bool Table::create(void)
+    {
+        if (created)
+        {
+            return true;
+        }
+        if (swTable_create(table) < 0)
+        {
+            swWarn("create table failed.");
+            return false;
+        }
+        created = true;
+        return true;
+    }
+
+    bool Table::setValue(const string &key, const string &column, ColumnType type, void *value, int length)
+    {
+        if (key.length() >= SW_TABLE_KEY_SIZE)
+        {
+            swWarn("key[%s] is too long.", key.c_str());
+            return false;
+        }
+        swTableColumn *col = get_value_column(table, column, type, length);
+        if (col == NULL)
+        {
+            return false;
+        }
+        if (type == TYPE_INT && !check_int(col, column, *(int64_t *) value))
+        {
+            return false;
+        }
+
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_set(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        if (row == NULL)
+        {
+            swTableRow_unlock(_rowlock);
+            swWarn("unable to allocate memory.");
+            return false;
+        }
+        swTableRow_set_value(row, col, value, length);
+        swTableRow_unlock(_rowlock);
+        return true;
+    }
+
+    bool Table::set(const string &key, const string &column, long value)
+    {
+        int64_t _value = value;
+        return setValue(key, column, TYPE_INT, &_value, 0);
+    }
+
+    bool Table::set(const string &key, const string &column, double value)
+    {
+        return setValue(key, column, TYPE_FLOAT, &value, 0);
+    }
+
+    bool Table::set(const string &key, const string &column, const string &value)
+    {
+        return setValue(key, column, TYPE_STRING, (void *) value.c_str(), (int) value.length());
+    }
+
+    bool Table::get(const string &key, const string &column, long &value)
+    {
+        swTableColumn *col = get_column(table, column);
+        if (col == NULL)
+        {
+            return false;
+        }
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_get(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        bool retval = row && read_int(row, col, value);
+        swTableRow_unlock(_rowlock);
+        return retval;
+    }
+
+    bool Table::get(const string &key, const string &column, double &value)
+    {
+        swTableColumn *col = get_column(table, column);
+        if (col == NULL)
+        {
+            return false;
+        }
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_get(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        bool retval = row && read_float(row, col, value);
+        swTableRow_unlock(_rowlock);
+        return retval;
+    }
+
+    bool Table::get(const string &key, const string &column, string &value)
+    {
+        swTableColumn *col = get_column(table, column);
+        if (col == NULL)
+        {
+            return false;
+        }
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_get(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        bool retval = row && read_string(row, col, value);
+        swTableRow_unlock(_rowlock);
+        return retval;
+    }
+
+    bool Table::incr(const string &key, const string &column, long incrby, long *value)
+    {
+        swTableColumn *col = get_column(table, column);
+        if (col == NULL || !is_int_column(col))
+        {
+            swWarn("column[%s] is not an integer column.", column.c_str());
+            return false;
+        }
+
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_set(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        if (row == NULL)
+        {
+            swTableRow_unlock(_rowlock);
+            return false;
+        }
+        long current = 0;
+        read_int(row, col, current);
+        int64_t _value = current + incrby;
+        if (!check_int(col, column, _value))
+        {
+            swTableRow_unlock(_rowlock);
+            return false;
+        }
+        swTableRow_set_value(row, col, &_value, 0);
+        swTableRow_unlock(_rowlock);
+
+        if (value)
+        {
+            *value = (long) _value;
+        }
+        return true;
+    }
+
+    bool Table::incr(const string &key, const string &column, double incrby, double *value)
+    {
+        swTableColumn *col = get_column(table, column);
+        if (col == NULL || col->type != SW_TABLE_FLOAT)
+        {
+            swWarn("column[%s] is not a float column.", column.c_str());
+            return false;
+        }
+
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_set(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        if (row == NULL)
+        {
+            swTableRow_unlock(_rowlock);
+            return false;
+        }
+        double _value = 0;
+        read_float(row, col, _value);
+        _value += incrby;
+        swTableRow_set_value(row, col, &_value, 0);
+        swTableRow_unlock(_rowlock);
+
+        if (value)
+        {
+            *value = _value;
+        }
+        return true;
+    }
+
+    bool Table::update(const char *key, size_t keylen, const function<void(TableRow &row)> &callback)
+    {
+        if (keylen >= SW_TABLE_KEY_SIZE)
+        {
+            swWarn("key[%.*s] is too long.", (int) keylen, key);
+            return false;
+        }
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_set(table, (char *) key, (int) keylen, &_rowlock);
+        if (row == NULL)
+        {
+            swTableRow_unlock(_rowlock);
+            return false;
+        }
+        TableRow _row(table, row);
+        callback(_row);
+        swTableRow_unlock(_rowlock);
+        return true;
+    }
+
+    bool Table::exists(const string &key)
+    {
+        swTableRow *_rowlock = NULL;
+        swTableRow *row = swTableRow_get(table, (char *) key.c_str(), (int) key.length(), &_rowlock);
+        swTableRow_unlock(_rowlock);
+        return row != NULL;
+    }
+
+    bool Table::del(const string &key)
+    {
+        return swTableRow_del(table, (char *) key.c_str(), (int) key.length()) == SW_OK;
+    }
+
+    size_t Table::count(void)
+    {
+        return table->row_num;
+    }
+
+    /**
+     * The iterator of libswoole lives in shared memory and would be moved by every process
+     * scanning at the same time, the position is kept on the stack instead.
+     * The lock of the first row of a bucket covers its collision chain.
+     */
+    void Table::each(const function<bool(const char *key, TableRow &row)> &callback)
+    {
+        for (size_t i = 0; i < table->size; i++)
+        {
+            swTableRow *head = table->rows[i];
+            swTableRow_lock(head);
+            bool _continue = true;
+            for (swTableRow *row = head; row != NULL && _continue; row = row->next)
+            {
+                if (row->active)
+                {
+                    TableRow _row(table, row);
+                    _continue = callback(row->key, _row);
+                }
+            }
+            swTableRow_unlock(head);
+            if (!_continue)
+            {
+                break;
+            }
+        }
+    }
+}
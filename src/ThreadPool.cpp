@@ -0,0 +1,220 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "ThreadPool.hpp"
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unordered_map>
+
+namespace swoole
+{
+    //eventfd -> pool, for the reactor callback
+    static unordered_map<int, ThreadPool *> pools;
+
+    ThreadPool::ThreadPool(int thread_num) :
+            round(0), pending(0), active(0)
+    {
+        running = true;
+        efd = eventfd(0, EFD_NONBLOCK);
+        if (efd < 0)
+        {
+            swSysError("eventfd() failed.");
+            abort();
+        }
+        for (int i = 0; i < thread_num; i++)
+        {
+            queues.push_back(new Queue);
+        }
+        //the threads inherit the mask, signals of the worker must not land on them
+        sigset_t all, old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        for (int i = 0; i < thread_num; i++)
+        {
+            threads.push_back(thread(&ThreadPool::run, this, i));
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            unique_lock<mutex> lock(sleep_lock);
+            running = false;
+        }
+        sleep_cond.notify_all();
+        for (auto iter = threads.begin(); iter != threads.end(); iter++)
+        {
+            iter->join();
+        }
+        for (auto iter = queues.begin(); iter != queues.end(); iter++)
+        {
+            delete *iter;
+        }
+        pools.erase(efd);
+        if (SwooleG.main_reactor)
+        {
+            SwooleG.main_reactor->del(SwooleG.main_reactor, efd);
+        }
+        ::close(efd);
+    }
+
+    void ThreadPool::dispatch(const Job &job)
+    {
+        Queue *queue = queues[round++ % queues.size()];
+        {
+            lock_guard<mutex> lock(queue->lock);
+            queue->jobs.push_back(job);
+        }
+        pending++;
+        {
+            //pairs with the predicate check of the sleeping threads
+            lock_guard<mutex> lock(sleep_lock);
+        }
+        sleep_cond.notify_one();
+    }
+
+    bool ThreadPool::pop(int id, Job &job)
+    {
+        size_t n = queues.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            Queue *queue = queues[(id + i) % n];
+            lock_guard<mutex> lock(queue->lock);
+            if (queue->jobs.empty())
+            {
+                continue;
+            }
+            //own queue from the back, keeps the cache warm; steal from the front
+            if (i == 0)
+            {
+                job = queue->jobs.back();
+                queue->jobs.pop_back();
+            }
+            else
+            {
+                job = queue->jobs.front();
+                queue->jobs.pop_front();
+            }
+            active++;
+            pending--;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::run(int id)
+    {
+        Job job;
+        while (true)
+        {
+            if (pop(id, job))
+            {
+                job();
+                job = nullptr;
+                active--;
+                continue;
+            }
+            unique_lock<mutex> lock(sleep_lock);
+            sleep_cond.wait(lock, [this]
+            {
+                return !running || pending > 0;
+            });
+            if (!running)
+            {
+                break;
+            }
+        }
+    }
+
+    void ThreadPool::complete(const Job &callback)
+    {
+        bool notify;
+        {
+            lock_guard<mutex> lock(completion_lock);
+            notify = completions.empty();
+            completions.push_back(callback);
+        }
+        //only the first completion of a batch needs to wake up the reactor
+        if (notify)
+        {
+            uint64_t flag = 1;
+            if (write(efd, &flag, sizeof(flag)) < 0)
+            {
+                swSysError("write(eventfd) failed.");
+            }
+        }
+    }
+
+    void ThreadPool::runCompletions(void)
+    {
+        uint64_t flag;
+        while (read(efd, &flag, sizeof(flag)) > 0);
+
+        vector<Job> jobs;
+        {
+            lock_guard<mutex> lock(completion_lock);
+            jobs.swap(completions);
+        }
+        for (auto iter = jobs.begin(); iter != jobs.end(); iter++)
+        {
+            (*iter)();
+        }
+    }
+
+    bool ThreadPool::attach(swReactor *reactor)
+    {
+        reactor->setHandle(reactor, FD_THREAD_POOL | SW_EVENT_READ, ThreadPool::onReactorRead);
+        if (reactor->add(reactor, efd, FD_THREAD_POOL | SW_EVENT_READ) < 0)
+        {
+            return false;
+        }
+        pools[efd] = this;
+        return true;
+    }
+
+    int ThreadPool::onReactorRead(swReactor *reactor, swEvent *event)
+    {
+        auto iter = pools.find(event->fd);
+        if (iter != pools.end())
+        {
+            iter->second->runCompletions();
+        }
+        return SW_OK;
+    }
+
+    void ThreadPool::wait(void)
+    {
+        struct pollfd pfd;
+        pfd.fd = efd;
+        pfd.events = POLLIN;
+
+        while (true)
+        {
+            //a finished job has posted its completion before it leaves the active count
+            bool idle = pending == 0 && active == 0;
+            runCompletions();
+            if (idle)
+            {
+                break;
+            }
+            poll(&pfd, 1, 100);
+        }
+    }
+}
@@ -22,12 +22,14 @@ namespace swoole
 {
     Timer::Timer(long ms)
     {
+        m_tnode = NULL;
         id = Timer::add(ms, this, true);
         interval = true;
     }
 
     Timer::Timer(long ms, bool _interval)
     {
+        m_tnode = NULL;
         id = Timer::add(ms, this, _interval);
         interval = _interval;
     }
@@ -43,9 +45,12 @@ namespace swoole
     {
         timer->_current_id = tnode->id;
         Timer *_this = (Timer *) tnode->data;
+        //detach first, the callback is allowed to destroy a one-shot timer
+        timer_map.erase(tnode->id);
+        _this->setNode(NULL);
         _this->callback();
         timer->_current_id = -1;
-        Timer::del(tnode);
+        swTimer_del(timer, tnode);
     }
 
     void Timer::_onTick(swTimer *timer, swTimer_node *tnode)
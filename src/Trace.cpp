@@ -0,0 +1,229 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "Trace.hpp"
+
+#include <mutex>
+#include <random>
+#include <limits.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+
+namespace swoole
+{
+    bool Tracer::enabled = false;
+    double Tracer::sample_rate = 0;
+    string Tracer::dir;
+
+    static thread_local TraceContext current_ctx = {0, 0};
+
+    //spans of this process, a forked child drops what it inherited
+    static mutex buffer_lock;
+    static string buffer;
+    static pid_t buffer_pid = 0;
+    static int trace_fd = -1;
+    static int64_t flush_usec = 0;
+
+    static inline int64_t now_usec(void)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    static void process_name(char *name, size_t size)
+    {
+        if (swIsMaster())
+        {
+            snprintf(name, size, "master");
+        }
+        else if (swIsManager())
+        {
+            snprintf(name, size, "manager");
+        }
+        else if (swIsTaskWorker())
+        {
+            snprintf(name, size, "task worker #%d", SwooleWG.id);
+        }
+        else
+        {
+            snprintf(name, size, "worker #%d", SwooleWG.id);
+        }
+    }
+
+    void Tracer::enable(const string &_dir, double _sample_rate)
+    {
+        dir = _dir;
+        sample_rate = _sample_rate;
+        enabled = true;
+    }
+
+    bool Tracer::sample(void)
+    {
+        if (!enabled || sample_rate <= 0)
+        {
+            return false;
+        }
+        if (sample_rate >= 1)
+        {
+            return true;
+        }
+        return (double) (newId() >> 11) / (double) (1ull << 53) < sample_rate;
+    }
+
+    TraceContext *Tracer::current(void)
+    {
+        return current_ctx.trace_id ? &current_ctx : NULL;
+    }
+
+    uint64_t Tracer::newId(void)
+    {
+        static thread_local mt19937_64 *generator = NULL;
+        if (generator == NULL)
+        {
+            random_device rd;
+            generator = new mt19937_64(((uint64_t) rd() << 32) ^ rd() ^ (uint64_t) getpid());
+        }
+        uint64_t id;
+        do
+        {
+            id = (*generator)();
+        } while (id == 0);
+        return id;
+    }
+
+    void Tracer::record(const char *name, const TraceContext &ctx, uint64_t parent_id, int64_t start_usec,
+                        int64_t end_usec)
+    {
+        char line[512];
+        pid_t pid = getpid();
+        int n = snprintf(line, sizeof(line),
+                         "{\"name\":\"%s\",\"cat\":\"swoole\",\"ph\":\"X\",\"ts\":%ld,\"dur\":%ld,\"pid\":%d,\"tid\":%ld,"
+                         "\"args\":{\"trace\":\"%016lx\",\"span\":\"%016lx\",\"parent\":\"%016lx\"}}\n",
+                         name, (long) start_usec, (long) (end_usec - start_usec), pid, (long) syscall(SYS_gettid),
+                         (unsigned long) ctx.trace_id, (unsigned long) ctx.span_id, (unsigned long) parent_id);
+        if (n <= 0 || n >= (int) sizeof(line))
+        {
+            return;
+        }
+
+        bool full;
+        {
+            lock_guard<mutex> lock(buffer_lock);
+            if (buffer_pid != pid)
+            {
+                buffer.clear();
+                buffer_pid = pid;
+                if (trace_fd >= 0)
+                {
+                    ::close(trace_fd);
+                    trace_fd = -1;
+                }
+            }
+            buffer.append(line, n);
+            //an idle process does not keep its spans for long either
+            full = buffer.length() >= SW_CPP_TRACE_BUFFER_SIZE || end_usec - flush_usec >= 1000000;
+        }
+        if (full)
+        {
+            flush();
+        }
+    }
+
+    void Tracer::flush(void)
+    {
+        lock_guard<mutex> lock(buffer_lock);
+        pid_t pid = getpid();
+        if (buffer.empty() || buffer_pid != pid)
+        {
+            return;
+        }
+        flush_usec = now_usec();
+        if (trace_fd < 0)
+        {
+            char file[PATH_MAX];
+            snprintf(file, sizeof(file), "%s/trace-%d.json", dir.c_str(), pid);
+            trace_fd = open(file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+            if (trace_fd < 0)
+            {
+                swSysError("open(%s) failed.", file);
+                buffer.clear();
+                return;
+            }
+            char name[64];
+            char meta[160];
+            process_name(name, sizeof(name));
+            int n = snprintf(meta, sizeof(meta),
+                             "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}\n", pid,
+                             name);
+            buffer.insert(0, meta, n);
+        }
+        if (::write(trace_fd, buffer.c_str(), buffer.length()) < 0)
+        {
+            swSysError("write(trace) failed.");
+        }
+        buffer.clear();
+    }
+
+    TraceSpan::TraceSpan(const char *_name)
+    {
+        begin(_name, Tracer::current());
+    }
+
+    TraceSpan::TraceSpan(const char *_name, const TraceContext *parent)
+    {
+        begin(_name, parent);
+    }
+
+    TraceSpan::TraceSpan(const char *_name, Root root)
+    {
+        if (!Tracer::sample())
+        {
+            name = _name;
+            active = false;
+            return;
+        }
+        TraceContext parent = {Tracer::newId(), 0};
+        begin(_name, &parent);
+    }
+
+    void TraceSpan::begin(const char *_name, const TraceContext *parent)
+    {
+        name = _name;
+        if (parent == NULL)
+        {
+            active = false;
+            return;
+        }
+        saved = current_ctx;
+        start_usec = now_usec();
+        ctx.span_id = Tracer::newId();
+        ctx.trace_id = parent->trace_id;
+        parent_id = parent->span_id;
+        current_ctx = ctx;
+        active = true;
+    }
+
+    TraceSpan::~TraceSpan()
+    {
+        if (!active)
+        {
+            return;
+        }
+        current_ctx = saved;
+        Tracer::record(name, ctx, parent_id, start_usec, now_usec());
+    }
+}
@@ -0,0 +1,167 @@
+/**
+ * Merge the trace-<pid>.json files written by Server::setTrace() into one Chrome trace,
+ * open it in chrome://tracing or https://ui.perfetto.dev
+ *
+ * ./trace_merge out.json /tmp/trace/trace-*.json [trace_id]
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+struct Event
+{
+    string json;
+    long ts;
+    long pid;
+    long tid;
+    string trace;
+    string span;
+    string parent;
+};
+
+static bool get_number(const string &line, const char *key, long *value)
+{
+    size_t pos = line.find(key);
+    if (pos == string::npos)
+    {
+        return false;
+    }
+    *value = strtol(line.c_str() + pos + strlen(key), NULL, 10);
+    return true;
+}
+
+static string get_string(const string &line, const char *key)
+{
+    size_t pos = line.find(key);
+    if (pos == string::npos)
+    {
+        return string();
+    }
+    pos += strlen(key);
+    size_t end = line.find('"', pos);
+    if (end == string::npos)
+    {
+        return string();
+    }
+    return line.substr(pos, end - pos);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s out.json trace-<pid>.json... [trace_id]\n", argv[0]);
+        return 1;
+    }
+
+    //a trailing argument that is not a file selects one trace
+    string only_trace;
+    int file_num = argc - 2;
+    if (argc > 3 && strchr(argv[argc - 1], '/') == NULL && strstr(argv[argc - 1], ".json") == NULL)
+    {
+        only_trace = argv[argc - 1];
+        file_num--;
+    }
+
+    vector<Event> events;
+    vector<string> metadata;
+    for (int i = 0; i < file_num; i++)
+    {
+        ifstream in(argv[2 + i]);
+        if (!in)
+        {
+            fprintf(stderr, "cannot open %s\n", argv[2 + i]);
+            continue;
+        }
+        string line;
+        while (getline(in, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+            if (line.find("\"ph\":\"M\"") != string::npos)
+            {
+                metadata.push_back(line);
+                continue;
+            }
+            Event ev;
+            ev.json = line;
+            if (!get_number(line, "\"ts\":", &ev.ts) || !get_number(line, "\"pid\":", &ev.pid)
+                    || !get_number(line, "\"tid\":", &ev.tid))
+            {
+                continue;
+            }
+            ev.trace = get_string(line, "\"trace\":\"");
+            ev.span = get_string(line, "\"span\":\"");
+            ev.parent = get_string(line, "\"parent\":\"");
+            if (!only_trace.empty() && ev.trace != only_trace)
+            {
+                continue;
+            }
+            events.push_back(ev);
+        }
+    }
+
+    sort(events.begin(), events.end(), [](const Event &a, const Event &b)
+    {
+        return a.ts < b.ts;
+    });
+
+    unordered_map<string, size_t> spans;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        spans[events[i].span] = i;
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (auto iter = metadata.begin(); iter != metadata.end(); iter++)
+    {
+        fprintf(out, "%s%s", first ? "" : ",\n", iter->c_str());
+        first = false;
+    }
+
+    long flow_id = 0;
+    for (auto iter = events.begin(); iter != events.end(); iter++)
+    {
+        fprintf(out, "%s%s", first ? "" : ",\n", iter->json.c_str());
+        first = false;
+
+        //an arrow from the span that sent the task or message to the span that handled it
+        auto parent = spans.find(iter->parent);
+        if (parent == spans.end())
+        {
+            continue;
+        }
+        const Event &from = events[parent->second];
+        if (from.pid == iter->pid && from.tid == iter->tid)
+        {
+            continue;
+        }
+        flow_id++;
+        fprintf(out, ",\n{\"name\":\"flow\",\"cat\":\"swoole\",\"ph\":\"s\",\"id\":%ld,\"ts\":%ld,\"pid\":%ld,\"tid\":%ld}",
+                flow_id, from.ts, from.pid, from.tid);
+        fprintf(out, ",\n{\"name\":\"flow\",\"cat\":\"swoole\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%ld,\"ts\":%ld,\"pid\":%ld,"
+                "\"tid\":%ld}", flow_id, iter->ts, iter->pid, iter->tid);
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(out);
+
+    printf("%ld spans, %ld flows, written to %s\n", (long) events.size(), flow_id, argv[1]);
+    return 0;
+}